@@ -25,200 +25,973 @@ SOFTWARE.
 
 #include "geomag.h"
 #include "math.h"
-
-// Model order
-#define WMM_NMAX 12
-
-// Number of coefficients
-#define WMM_TOT_COEFFS ((WMM_NMAX + 1) * (WMM_NMAX + 2) / 2)
-
-// Epoch of model in decimal year
-static const real WMM_EPOCH = 2020;
+#include "stdio.h"
+#include "stdlib.h"
 
 // Mean radius of ellipsoid
 static const real EARTH_R = 6371200.0;
 
-// Declared here, initialized below because the table is hefty
-struct WMM_COEFF_SET {
-    real main_field_c, main_field_s;
-    real sec_var_c, sec_var_s;
-};
+static const real PI = 3.14159265358979323846;
 
-// Table of coefficients
-static const struct WMM_COEFF_SET WMM_COEFFS[WMM_TOT_COEFFS];
+// Positions per block of `geomag_elements_batch`
+#define ELEMENTS_BLOCK 64
 
 static int calc_index(const int n, const int m) {
     return m * (2 * WMM_NMAX - m + 1) / 2 + n;
 }
 
-static real C(const int idx, const real t_since) {
-    return WMM_COEFFS[idx].main_field_c + t_since * WMM_COEFFS[idx].sec_var_c;
+static int calc_basis_index(const int n, const int m) {
+    return n * (n + 1) / 2 + m;
 }
 
-static real S(const int idx, const real t_since) {
-    return WMM_COEFFS[idx].main_field_s + t_since * WMM_COEFFS[idx].sec_var_s;
+static real C(const struct geomag_model *model, const int idx, const real t_since) {
+    return model->coeffs[idx].main_field_c + t_since * model->coeffs[idx].sec_var_c;
 }
 
-void geomag(const real dyear, const real (*pos_itrf)[3], real (*mag_itrf)[3]) {
-    const real t = dyear - WMM_EPOCH;
+static real S(const struct geomag_model *model, const int idx, const real t_since) {
+    return model->coeffs[idx].main_field_s + t_since * model->coeffs[idx].sec_var_s;
+}
+
+// State of the V_nm, W_nm recurrence, stepped through by m then n
+struct recurrence {
+    real a, b, f, g;
+    real V_top, W_top;
+    real V_prev, W_prev;
+    real V_nm, W_nm;
+};
+
+static void recurrence_init(struct recurrence *r, const real (*pos_itrf)[3]) {
     const real x = (*pos_itrf)[0];
     const real y = (*pos_itrf)[1];
     const real z = (*pos_itrf)[2];
     const real pos_norm_sq = x * x + y * y + z * z;
     const real abf_mul = EARTH_R / pos_norm_sq;
-    const real a = abf_mul * x;
-    const real b = abf_mul * y;
-    const real f = abf_mul * z;
-    const real g = abf_mul * EARTH_R;
-
-    real V_top = EARTH_R / REAL_SQRT(pos_norm_sq);
-    real W_top = 0;
-    real V_prev = 0;
-    real W_prev = 0;
-    real V_nm = V_top;
-    real W_nm = W_top;
+    r->a = abf_mul * x;
+    r->b = abf_mul * y;
+    r->f = abf_mul * z;
+    r->g = abf_mul * EARTH_R;
+
+    r->V_top = EARTH_R / REAL_SQRT(pos_norm_sq);
+    r->W_top = 0;
+    r->V_prev = 0;
+    r->W_prev = 0;
+    r->V_nm = r->V_top;
+    r->W_nm = r->W_top;
+}
+
+// Advances to (n, m), which must directly follow the previous step
+static void recurrence_step(struct recurrence *r, const int n, const int m) {
+    if (m == n) {
+        if (m != 0) {
+            const real prev_V_top = r->V_top;
+            r->V_top = (2 * m - 1) * (r->a * r->V_top - r->b * r->W_top);
+            r->W_top = (2 * m - 1) * (r->a * r->W_top + r->b * prev_V_top);
+            r->V_prev = 0;
+            r->W_prev = 0;
+            r->V_nm = r->V_top;
+            r->W_nm = r->W_top;
+        }
+    } else {
+        const real prev_V_nm = r->V_nm;
+        const real inv_nm = ((real) 1) / (n - m);
+        r->V_nm = ((2 * n - 1) * r->f * r->V_nm - (n + m - 1) * r->g * r->V_prev) * inv_nm;
+        r->V_prev = prev_V_nm;
+        const real prev_W_nm = r->W_nm;
+        r->W_nm = ((2 * n - 1) * r->f * r->W_nm - (n + m - 1) * r->g * r->W_prev) * inv_nm;
+        r->W_prev = prev_W_nm;
+    }
+}
+
+// Adds the contribution of basis term (n, m) to the field in [nT], negated
+static void accumulate(
+    const struct geomag_model *model, const int n, const int m, const real t,
+    const real V_nm, const real W_nm, real *px, real *py, real *pz
+) {
+    if (m < WMM_NMAX && n >= m + 2) {
+        const int idx = calc_index(n - 1, m + 1);
+        const real nm_coeff = REAL_HALF * (n - m) * (n - m - 1);
+        *px += nm_coeff * (C(model, idx, t) * V_nm + S(model, idx, t) * W_nm);
+        *py += nm_coeff * (-C(model, idx, t) * W_nm + S(model, idx, t) * V_nm);
+    }
+    if (m >= 2 && n >= 2) {
+        const int idx = calc_index(n - 1, m - 1);
+        *px += REAL_HALF * (-C(model, idx, t) * V_nm - S(model, idx, t) * W_nm);
+        *py += REAL_HALF * (-C(model, idx, t) * W_nm + S(model, idx, t) * V_nm);
+    }
+    if (m == 1 && n >= 2) {
+        const int idx = calc_index(n - 1, 0);
+        *px += -C(model, idx, t) * V_nm;
+        *py += -C(model, idx, t) * W_nm;
+    }
+    if (m < n && n >= 2) {
+        const int idx = calc_index(n - 1, m);
+        *pz += (n - m) * (-C(model, idx, t) * V_nm - S(model, idx, t) * W_nm);
+    }
+}
+
+static void store_field(const real px, const real py, const real pz, real (*mag_itrf)[3]) {
+    // Convert [nT] to [T]
+    (*mag_itrf)[0] = px * -REAL_NT2T;
+    (*mag_itrf)[1] = py * -REAL_NT2T;
+    (*mag_itrf)[2] = pz * -REAL_NT2T;
+}
+
+void geomag(const real dyear, const real (*pos_itrf)[3], real (*mag_itrf)[3]) {
+    geomag_eval(&WMM2020, dyear, pos_itrf, mag_itrf);
+}
+
+void geomag_eval(
+    const struct geomag_model *model, const real dyear, const real (*pos_itrf)[3], real (*mag_itrf)[3]
+) {
+    const real t = dyear - model->epoch;
+    struct recurrence r;
+    recurrence_init(&r, pos_itrf);
+    real px = 0, py = 0, pz = 0;
+
+    for (int m = 0; m <= WMM_NMAX + 1; ++m) {
+        for (int n = m; n <= WMM_NMAX + 1; ++n) {
+            recurrence_step(&r, n, m);
+            accumulate(model, n, m, t, r.V_nm, r.W_nm, &px, &py, &pz);
+        }
+    }
+    store_field(px, py, pz, mag_itrf);
+}
+
+void geomag_batch(
+    const struct geomag_model *model, const size_t count, const real *dyear,
+    const real (*pos_itrf)[3], real (*mag_itrf)[3]
+) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_eval(model, dyear[i], &pos_itrf[i], &mag_itrf[i]);
+    }
+}
+
+real geomag_gmst(const real dyear) {
+    // Julian date of 0h UTC on 1 January, then the fraction of the year
+    const real year = REAL_FLOOR(dyear);
+    const long y = (long) year - 1;
+    const real jd_year = 1721425.5 + 365.0 * (real) y + (real) (y / 4 - y / 100 + y / 400);
+    const long next = y + 1;
+    const int leap = (next % 4 == 0 && next % 100 != 0) || next % 400 == 0;
+    const real days = (dyear - year) * (leap ? 366 : 365);
+    // IAU 1982 GMST, with days counted from J2000.0
+    const real d = (jd_year - 2451545.0) + days;
+    const real c = d / 36525;
+    const real deg = 280.46061837 + 360.98564736629 * d + c * c * (0.000387933 - c / 38710000);
+    const real turns = deg / 360;
+    return (turns - REAL_FLOOR(turns)) * 2 * PI;
+}
+
+// Rotates an ITRF field vector into an output frame
+static void store_frame(
+    const enum geomag_frame frame, const real dyear, const real (*pos_itrf)[3], const real *quat,
+    const real (*mag_itrf)[3], real (*mag_out)[3]
+) {
+    const real bx = (*mag_itrf)[0], by = (*mag_itrf)[1], bz = (*mag_itrf)[2];
+    switch (frame) {
+    case GEOMAG_FRAME_NED:
+    case GEOMAG_FRAME_ENU: {
+        real lat, lon, height, ned[3][3];
+        geomag_itrf_to_geodetic(pos_itrf, &lat, &lon, &height);
+        geomag_ned_frame(lat, lon, ned);
+        real out[3];
+        for (int i = 0; i < 3; ++i) {
+            out[i] = ned[i][0] * bx + ned[i][1] * by + ned[i][2] * bz;
+        }
+        if (frame == GEOMAG_FRAME_NED) {
+            (*mag_out)[0] = out[0];
+            (*mag_out)[1] = out[1];
+            (*mag_out)[2] = out[2];
+        } else {
+            (*mag_out)[0] = out[1];
+            (*mag_out)[1] = out[0];
+            (*mag_out)[2] = -out[2];
+        }
+        break;
+    }
+    case GEOMAG_FRAME_SPHERICAL: {
+        const real x = (*pos_itrf)[0], y = (*pos_itrf)[1], z = (*pos_itrf)[2];
+        const real rho = REAL_SQRT(x * x + y * y);
+        const real r = REAL_SQRT(rho * rho + z * z);
+        // Longitude is arbitrary on the polar axis, so take 0
+        const real cos_lon = (rho > 0) ? x / rho : 1, sin_lon = (rho > 0) ? y / rho : 0;
+        const real b_horiz = cos_lon * bx + sin_lon * by;
+        (*mag_out)[0] = (rho * b_horiz + z * bz) / r;
+        (*mag_out)[1] = (z * b_horiz - rho * bz) / r;
+        (*mag_out)[2] = cos_lon * by - sin_lon * bx;
+        break;
+    }
+    case GEOMAG_FRAME_ECI:
+    case GEOMAG_FRAME_BODY: {
+        const real gmst = geomag_gmst(dyear);
+        const real c = REAL_COS(gmst), s = REAL_SIN(gmst);
+        const real eci[3] = {c * bx - s * by, s * bx + c * by, bz};
+        if (frame == GEOMAG_FRAME_ECI) {
+            (*mag_out)[0] = eci[0];
+            (*mag_out)[1] = eci[1];
+            (*mag_out)[2] = eci[2];
+            break;
+        }
+        // Rotate by the inverse of the unit quaternion, v' = q* v q
+        const real w = quat[0], qv[3] = {quat[1], quat[2], quat[3]};
+        const real t[3] = {
+            2 * (qv[2] * eci[1] - qv[1] * eci[2]),
+            2 * (qv[0] * eci[2] - qv[2] * eci[0]),
+            2 * (qv[1] * eci[0] - qv[0] * eci[1])
+        };
+        (*mag_out)[0] = eci[0] + w * t[0] - (qv[1] * t[2] - qv[2] * t[1]);
+        (*mag_out)[1] = eci[1] + w * t[1] - (qv[2] * t[0] - qv[0] * t[2]);
+        (*mag_out)[2] = eci[2] + w * t[2] - (qv[0] * t[1] - qv[1] * t[0]);
+        break;
+    }
+    default:
+        (*mag_out)[0] = bx;
+        (*mag_out)[1] = by;
+        (*mag_out)[2] = bz;
+        break;
+    }
+}
+
+void geomag_batch_frame(
+    const struct geomag_model *model, const size_t count, const real *dyear, const real (*pos_itrf)[3],
+    const enum geomag_frame frame, const real (*quat)[4], real (*mag_out)[3]
+) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        real mag[3];
+        geomag_eval(model, dyear[i], &pos_itrf[i], &mag);
+        store_frame(
+            frame, dyear[i], &pos_itrf[i], (frame == GEOMAG_FRAME_BODY) ? quat[i] : NULL,
+            (const real (*)[3]) &mag, &mag_out[i]
+        );
+    }
+}
+
+// Element `i` of an array with a byte stride
+#define STRIDED(type, base, stride, i) ((type) ((const char *) (base) + (i) * (stride)))
+
+void geomag_batch_strided(
+    const struct geomag_model *model, const size_t count, const real *dyear, const size_t dyear_stride,
+    const real *pos_itrf, const size_t pos_stride, const enum geomag_frame frame, const real *quat,
+    const size_t quat_stride, real *mag_out, const size_t mag_stride
+) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        const real sample_dyear = *STRIDED(const real *, dyear, dyear_stride, i);
+        const real (*pos)[3] = STRIDED(const real (*)[3], pos_itrf, pos_stride, i);
+        const real *sample_quat = (frame == GEOMAG_FRAME_BODY) ? STRIDED(const real *, quat, quat_stride, i) : NULL;
+        real (*out)[3] = (real (*)[3]) ((char *) mag_out + i * mag_stride);
+        real mag[3];
+        geomag_eval(model, sample_dyear, pos, &mag);
+        store_frame(frame, sample_dyear, pos, sample_quat, (const real (*)[3]) &mag, out);
+    }
+}
+
+void geomag_basis(const real (*pos_itrf)[3], struct geomag_basis *basis) {
+    struct recurrence r;
+    recurrence_init(&r, pos_itrf);
+
+    for (int m = 0; m <= WMM_NMAX + 1; ++m) {
+        for (int n = m; n <= WMM_NMAX + 1; ++n) {
+            recurrence_step(&r, n, m);
+            const int idx = calc_basis_index(n, m);
+            basis->V[idx] = r.V_nm;
+            basis->W[idx] = r.W_nm;
+        }
+    }
+}
+
+void geomag_basis_rotate(const struct geomag_basis *basis, const real dlon, struct geomag_basis *rotated) {
+    const real cos_dlon = REAL_COS(dlon);
+    const real sin_dlon = REAL_SIN(dlon);
+    // Order m rotates by e^{i m dlon}, stepped by angle addition
+    real cos_m = 1, sin_m = 0;
+
+    for (int m = 0; m <= WMM_NMAX + 1; ++m) {
+        for (int n = m; n <= WMM_NMAX + 1; ++n) {
+            const int idx = calc_basis_index(n, m);
+            const real V_nm = basis->V[idx];
+            const real W_nm = basis->W[idx];
+            rotated->V[idx] = cos_m * V_nm - sin_m * W_nm;
+            rotated->W[idx] = sin_m * V_nm + cos_m * W_nm;
+        }
+        const real prev_cos_m = cos_m;
+        cos_m = cos_m * cos_dlon - sin_m * sin_dlon;
+        sin_m = sin_m * cos_dlon + prev_cos_m * sin_dlon;
+    }
+}
+
+void geomag_basis_batch(const size_t count, const real (*pos_itrf)[3], struct geomag_basis *basis) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_basis(&pos_itrf[i], &basis[i]);
+    }
+}
+
+void geomag_basis_field(
+    const struct geomag_model *model, const real dyear, const struct geomag_basis *basis, real (*mag_itrf)[3]
+) {
+    const real t = dyear - model->epoch;
     real px = 0, py = 0, pz = 0;
 
     for (int m = 0; m <= WMM_NMAX + 1; ++m) {
         for (int n = m; n <= WMM_NMAX + 1; ++n) {
-            if (m == n) {
-                if (m != 0) {
-                    const real prev_V_top = V_top;
-                    V_top = (2 * m - 1) * (a * V_top - b * W_top);
-                    W_top = (2 * m - 1) * (a * W_top + b * prev_V_top);
-                    V_prev = 0;
-                    W_prev = 0;
-                    V_nm = V_top;
-                    W_nm = W_top;
+            const int idx = calc_basis_index(n, m);
+            accumulate(model, n, m, t, basis->V[idx], basis->W[idx], &px, &py, &pz);
+        }
+    }
+    store_field(px, py, pz, mag_itrf);
+}
+
+void geomag_basis_field_batch(
+    const struct geomag_model *model, const size_t count, const real *dyear,
+    const struct geomag_basis *basis, real (*mag_itrf)[3]
+) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_basis_field(model, dyear[i], &basis[i], &mag_itrf[i]);
+    }
+}
+
+// Highest basis degree needed for the second derivatives of the field
+#define JET_NMAX (WMM_NMAX + 3)
+
+// Number of basis terms up to `JET_NMAX`
+#define JET_LEN ((JET_NMAX + 1) * (JET_NMAX + 2) / 2)
+
+// Coefficients of a harmonic function sum(c * V_nm + s * W_nm), indexed
+// like the basis
+struct harmonic {
+    real c[JET_LEN];
+    real s[JET_LEN];
+};
+
+// Sets `h` to the potential of the model, or its rate of change if `rate`
+static void harmonic_potential(
+    const struct geomag_model *model, const real t, const int rate, struct harmonic *h
+) {
+    h->c[0] = 0;
+    h->s[0] = 0;
+    for (int n = 1; n <= WMM_NMAX; ++n) {
+        for (int m = 0; m <= n; ++m) {
+            const int idx = calc_index(n, m);
+            const int basis_idx = calc_basis_index(n, m);
+            h->c[basis_idx] = rate ? model->coeffs[idx].sec_var_c : C(model, idx, t);
+            h->s[basis_idx] = rate ? model->coeffs[idx].sec_var_s : S(model, idx, t);
+        }
+    }
+}
+
+// Sets `d` to EARTH_R times the derivative of `h` along an axis.
+//
+// Same identities that `accumulate` is built on, see sections 3.2.4 and
+// 3.2.5 of Montenbruck and Gill. Raises the degree by one, from `nmax`.
+static void harmonic_derivative(const int axis, const int nmax, const struct harmonic *h, struct harmonic *d) {
+    for (int idx = 0; idx < calc_basis_index(nmax + 2, 0); ++idx) {
+        d->c[idx] = 0;
+        d->s[idx] = 0;
+    }
+    for (int n = 0; n <= nmax; ++n) {
+        for (int m = 0; m <= n; ++m) {
+            const int idx = calc_basis_index(n, m);
+            const real c = h->c[idx];
+            const real s = h->s[idx];
+            if (axis == 2) {
+                const int up = calc_basis_index(n + 1, m);
+                d->c[up] -= (n - m + 1) * c;
+                d->s[up] -= (n - m + 1) * s;
+                continue;
+            }
+            const int up = calc_basis_index(n + 1, m + 1);
+            if (m == 0) {
+                if (axis == 0) {
+                    d->c[up] -= c;
+                } else {
+                    d->s[up] -= c;
                 }
+                continue;
+            }
+            const int down = calc_basis_index(n + 1, m - 1);
+            const real nm_coeff = REAL_HALF * (n - m + 2) * (n - m + 1);
+            if (axis == 0) {
+                d->c[up] -= REAL_HALF * c;
+                d->s[up] -= REAL_HALF * s;
+                d->c[down] += nm_coeff * c;
+                d->s[down] += nm_coeff * s;
             } else {
-                const real prev_V_nm = V_nm;
-                const real inv_nm = ((real) 1) / (n - m);
-                V_nm = ((2 * n - 1) * f * V_nm - (n + m - 1) * g * V_prev) * inv_nm;
-                V_prev = prev_V_nm;
-                const real prev_W_nm = W_nm;
-                W_nm = ((2 * n - 1) * f * W_nm - (n + m - 1) * g * W_prev) * inv_nm;
-                W_prev = prev_W_nm;
+                d->c[up] += REAL_HALF * s;
+                d->s[up] -= REAL_HALF * c;
+                d->c[down] += nm_coeff * s;
+                d->s[down] -= nm_coeff * c;
             }
-            if (m < WMM_NMAX && n >= m + 2) {
-                const int idx = calc_index(n - 1, m + 1);
-                const real nm_coeff = REAL_HALF * (n - m) * (n - m - 1);
-                px += nm_coeff * (C(idx, t) * V_nm + S(idx, t) * W_nm);
-                py += nm_coeff * (-C(idx, t) * W_nm + S(idx, t) * V_nm);
+        }
+    }
+}
+
+static real harmonic_eval(const int nmax, const struct harmonic *h, const real *V, const real *W) {
+    real sum = 0;
+    for (int idx = 0; idx < calc_basis_index(nmax + 1, 0); ++idx) {
+        sum += h->c[idx] * V[idx] + h->s[idx] * W[idx];
+    }
+    return sum;
+}
+
+void geomag_jet(
+    const struct geomag_model *model, const real dyear, const real (*pos_itrf)[3], int order,
+    struct geomag_jet *jet
+) {
+    // The basis arrays hold at most two extra degrees
+    order = (order < 0) ? 0 : ((order > 2) ? 2 : order);
+    const int basis_nmax = WMM_NMAX + 1 + order;
+    real V[JET_LEN], W[JET_LEN];
+    struct recurrence r;
+    recurrence_init(&r, pos_itrf);
+    for (int m = 0; m <= basis_nmax; ++m) {
+        for (int n = m; n <= basis_nmax; ++n) {
+            recurrence_step(&r, n, m);
+            V[calc_basis_index(n, m)] = r.V_nm;
+            W[calc_basis_index(n, m)] = r.W_nm;
+        }
+    }
+
+    // Each derivative of the potential divides by EARTH_R and the field is
+    // minus the gradient, converted from [nT] to [T]
+    const real scale[3] = {-REAL_NT2T, -REAL_NT2T / EARTH_R, -REAL_NT2T / (EARTH_R * EARTH_R)};
+    struct harmonic potential, d1, d2, d3;
+    harmonic_potential(model, dyear - model->epoch, 1, &potential);
+    for (int i = 0; i < 3; ++i) {
+        harmonic_derivative(i, WMM_NMAX, &potential, &d1);
+        jet->mag_rate[i] = scale[0] * harmonic_eval(WMM_NMAX + 1, &d1, V, W);
+    }
+    harmonic_potential(model, dyear - model->epoch, 0, &potential);
+
+    for (int i = 0; i < 3; ++i) {
+        harmonic_derivative(i, WMM_NMAX, &potential, &d1);
+        jet->mag[i] = scale[0] * harmonic_eval(WMM_NMAX + 1, &d1, V, W);
+        if (order < 1) {
+            continue;
+        }
+        // Derivatives commute, so only j >= i and k >= j are evaluated
+        for (int j = i; j < 3; ++j) {
+            harmonic_derivative(j, WMM_NMAX + 1, &d1, &d2);
+            jet->grad[i][j] = scale[1] * harmonic_eval(WMM_NMAX + 2, &d2, V, W);
+            jet->grad[j][i] = jet->grad[i][j];
+            if (order < 2) {
+                continue;
             }
-            if (m >= 2 && n >= 2) {
-                const int idx = calc_index(n - 1, m - 1);
-                px += REAL_HALF * (-C(idx, t) * V_nm - S(idx, t) * W_nm);
-                py += REAL_HALF * (-C(idx, t) * W_nm + S(idx, t) * V_nm);
+            for (int k = j; k < 3; ++k) {
+                harmonic_derivative(k, WMM_NMAX + 2, &d2, &d3);
+                const real value = scale[2] * harmonic_eval(WMM_NMAX + 3, &d3, V, W);
+                jet->hess[i][j][k] = value;
+                jet->hess[i][k][j] = value;
+                jet->hess[j][i][k] = value;
+                jet->hess[j][k][i] = value;
+                jet->hess[k][i][j] = value;
+                jet->hess[k][j][i] = value;
             }
-            if (m == 1 && n >= 2) {
-                const int idx = calc_index(n - 1, 0);
-                px += -C(idx, t) * V_nm;
-                py += -C(idx, t) * W_nm;
+        }
+    }
+}
+
+// Adds the design matrix entries of basis term (n, m), matching `accumulate`
+static void accumulate_design(
+    const int n, const int m, const real V_nm, const real W_nm, real (*design)[GEOMAG_DESIGN_COLS]
+) {
+    const real scale = -REAL_NT2T;
+    if (m < WMM_NMAX && n >= m + 2) {
+        const int idx = calc_index(n - 1, m + 1);
+        const real nm_coeff = scale * REAL_HALF * (n - m) * (n - m - 1);
+        design[0][2 * idx] += nm_coeff * V_nm;
+        design[0][2 * idx + 1] += nm_coeff * W_nm;
+        design[1][2 * idx] += -nm_coeff * W_nm;
+        design[1][2 * idx + 1] += nm_coeff * V_nm;
+    }
+    if (m >= 2 && n >= 2) {
+        const int idx = calc_index(n - 1, m - 1);
+        design[0][2 * idx] += scale * REAL_HALF * -V_nm;
+        design[0][2 * idx + 1] += scale * REAL_HALF * -W_nm;
+        design[1][2 * idx] += scale * REAL_HALF * -W_nm;
+        design[1][2 * idx + 1] += scale * REAL_HALF * V_nm;
+    }
+    if (m == 1 && n >= 2) {
+        const int idx = calc_index(n - 1, 0);
+        design[0][2 * idx] += scale * -V_nm;
+        design[1][2 * idx] += scale * -W_nm;
+    }
+    if (m < n && n >= 2) {
+        const int idx = calc_index(n - 1, m);
+        design[2][2 * idx] += scale * (n - m) * -V_nm;
+        design[2][2 * idx + 1] += scale * (n - m) * -W_nm;
+    }
+}
+
+void geomag_design(const real (*pos_itrf)[3], real (*design)[GEOMAG_DESIGN_COLS]) {
+    for (int i = 0; i < 3; ++i) {
+        for (int col = 0; col < GEOMAG_DESIGN_COLS; ++col) {
+            design[i][col] = 0;
+        }
+    }
+    struct recurrence r;
+    recurrence_init(&r, pos_itrf);
+
+    for (int m = 0; m <= WMM_NMAX + 1; ++m) {
+        for (int n = m; n <= WMM_NMAX + 1; ++n) {
+            recurrence_step(&r, n, m);
+            accumulate_design(n, m, r.V_nm, r.W_nm, design);
+        }
+    }
+}
+
+void geomag_design_batch(const size_t count, const real (*pos_itrf)[3], real (*design)[GEOMAG_DESIGN_COLS]) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_design(&pos_itrf[i], &design[3 * i]);
+    }
+}
+
+void geomag_model_coeffs(const struct geomag_model *model, const real dyear, real *coeffs, const size_t stride) {
+    const real t = dyear - model->epoch;
+    for (int idx = 0; idx < WMM_TOT_COEFFS; ++idx) {
+        coeffs[(2 * idx) * stride] = C(model, idx, t);
+        coeffs[(2 * idx + 1) * stride] = S(model, idx, t);
+    }
+}
+
+// Block sizes of the design product, sized so a block of coefficient
+// columns stays in L2 cache while rows stream through
+#define DESIGN_ROW_BLOCK 64
+#define DESIGN_K_BLOCK 64
+
+void geomag_design_product(
+    const size_t rows, const size_t k, const real (*design)[GEOMAG_DESIGN_COLS], const real *coeffs, real *mag
+) {
+    const long num_row_blocks = (long) ((rows + DESIGN_ROW_BLOCK - 1) / DESIGN_ROW_BLOCK);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (long block = 0; block < num_row_blocks; ++block) {
+        const size_t row_begin = (size_t) block * DESIGN_ROW_BLOCK;
+        const size_t row_end = (row_begin + DESIGN_ROW_BLOCK < rows) ? row_begin + DESIGN_ROW_BLOCK : rows;
+        for (size_t k_begin = 0; k_begin < k; k_begin += DESIGN_K_BLOCK) {
+            const size_t k_end = (k_begin + DESIGN_K_BLOCK < k) ? k_begin + DESIGN_K_BLOCK : k;
+            for (size_t i = row_begin; i < row_end; ++i) {
+                real *out = &mag[i * k];
+                for (size_t j = k_begin; j < k_end; ++j) {
+                    out[j] = 0;
+                }
+                for (int col = 0; col < GEOMAG_DESIGN_COLS; ++col) {
+                    const real d = design[i][col];
+                    if (d == 0) {
+                        // Sine terms of order 0 and the (0, 0) term are always zero
+                        continue;
+                    }
+                    const real *coeff_row = &coeffs[col * k];
+                    for (size_t j = k_begin; j < k_end; ++j) {
+                        out[j] += d * coeff_row[j];
+                    }
+                }
             }
-            if (m < n && n >= 2) {
-                const int idx = calc_index(n - 1, m);
-                pz += (n - m) * (-C(idx, t) * V_nm - S(idx, t) * W_nm);
+        }
+    }
+}
+
+// Factor to un-Schmidt-normalize a coefficient, as in `wmmcodeupdate.py`
+static real unnormalize_factor(const int n, const int m) {
+    if (m == 0) {
+        return 1;
+    }
+    // 2 * (n - m)! / (n + m)!
+    real ratio = 2;
+    for (int k = n - m + 1; k <= n + m; ++k) {
+        ratio /= k;
+    }
+    return REAL_SQRT(ratio);
+}
+
+// Skips to the start of the next line
+static const char *next_line(const char *text) {
+    while (*text != '\0' && *text != '\n') {
+        ++text;
+    }
+    return (*text == '\n') ? text + 1 : text;
+}
+
+int geomag_model_parse_cof(const char *text, struct geomag_model *model) {
+    char *end;
+    model->epoch = (real) strtod(text, &end);
+    if (end == text) {
+        return -1;
+    }
+    for (int idx = 0; idx < WMM_TOT_COEFFS; ++idx) {
+        model->coeffs[idx].main_field_c = 0;
+        model->coeffs[idx].main_field_s = 0;
+        model->coeffs[idx].sec_var_c = 0;
+        model->coeffs[idx].sec_var_s = 0;
+    }
+
+    // Each coefficient must appear exactly once, so a repeated row can't
+    // stand in for a missing one
+    unsigned char seen[WMM_TOT_COEFFS] = {0};
+    for (text = next_line(text); *text != '\0'; text = next_line(text)) {
+        const long n = strtol(text, &end, 10);
+        if (end == text) {
+            // Blank line
+            continue;
+        }
+        if (n >= 9999) {
+            // Terminating row of 9s
+            break;
+        }
+        const char *field = end;
+        const long m = strtol(field, &end, 10);
+        real values[4];
+        for (int k = 0; k < 4 && end != field; ++k) {
+            field = end;
+            values[k] = (real) strtod(field, &end);
+        }
+        if (end == field || n < 1 || m < 0 || m > n) {
+            return -1;
+        }
+        if (n > WMM_NMAX) {
+            // Truncate higher degree models to the compiled order
+            continue;
+        }
+        const real unnorm = unnormalize_factor((int) n, (int) m);
+        const int idx = calc_index((int) n, (int) m);
+        if (seen[idx]) {
+            return -1;
+        }
+        seen[idx] = 1;
+        model->coeffs[idx].main_field_c = values[0] * unnorm;
+        model->coeffs[idx].main_field_s = values[1] * unnorm;
+        model->coeffs[idx].sec_var_c = values[2] * unnorm;
+        model->coeffs[idx].sec_var_s = values[3] * unnorm;
+    }
+    // Every coefficient except (0, 0), at index 0, must be present
+    for (int idx = 1; idx < WMM_TOT_COEFFS; ++idx) {
+        if (!seen[idx]) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int geomag_model_write_cof(
+    const struct geomag_model *model, const char *name, const char *date, char *text, const size_t size
+) {
+    size_t len = 0;
+    int written = snprintf(text, size, "%10.1f            %-16s%s\n", (double) model->epoch, name, date);
+    if (written < 0) {
+        return -1;
+    }
+    len += (size_t) written;
+
+    for (int n = 1; n <= WMM_NMAX; ++n) {
+        for (int m = 0; m <= n; ++m) {
+            const struct WMM_COEFF_SET *coeff = &model->coeffs[calc_index(n, m)];
+            const real norm = 1 / unnormalize_factor(n, m);
+            written = snprintf(
+                (len < size) ? text + len : NULL, (len < size) ? size - len : 0,
+                "%3d%3d%10.1f%10.1f%11.1f%11.1f\n", n, m,
+                (double) (coeff->main_field_c * norm), (double) (coeff->main_field_s * norm),
+                (double) (coeff->sec_var_c * norm), (double) (coeff->sec_var_s * norm)
+            );
+            if (written < 0) {
+                return -1;
             }
+            len += (size_t) written;
         }
     }
-    // Convert [nT] to [T]
-    (*mag_itrf)[0] = px * -REAL_NT2T;
-    (*mag_itrf)[1] = py * -REAL_NT2T;
-    (*mag_itrf)[2] = pz * -REAL_NT2T;
+    static const char terminator[] =
+        "999999999999999999999999999999999999999999999999\n"
+        "999999999999999999999999999999999999999999999999\n";
+    written = snprintf((len < size) ? text + len : NULL, (len < size) ? size - len : 0, "%s", terminator);
+    if (written < 0) {
+        return -1;
+    }
+    len += (size_t) written;
+    return (int) len;
+}
+
+// Position at a geodetic coordinate, from its sines and cosines
+static void geodetic_position(
+    const real sin_lat, const real cos_lat, const real sin_lon, const real cos_lon, const real height,
+    real (*pos_itrf)[3]
+) {
+    const real n = GEOMAG_WGS84_A / REAL_SQRT(1 - GEOMAG_WGS84_E2 * sin_lat * sin_lat);
+    (*pos_itrf)[0] = (n + height) * cos_lat * cos_lon;
+    (*pos_itrf)[1] = (n + height) * cos_lat * sin_lon;
+    (*pos_itrf)[2] = (n * (1 - GEOMAG_WGS84_E2) + height) * sin_lat;
+}
+
+void geomag_geodetic_to_itrf(const real lat, const real lon, const real height, real (*pos_itrf)[3]) {
+    geodetic_position(REAL_SIN(lat), REAL_COS(lat), REAL_SIN(lon), REAL_COS(lon), height, pos_itrf);
+}
+
+void geomag_itrf_to_geodetic(const real (*pos_itrf)[3], real *lat, real *lon, real *height) {
+    const real x = (*pos_itrf)[0], y = (*pos_itrf)[1], z = (*pos_itrf)[2];
+    const real p = REAL_SQRT(x * x + y * y);
+    *lon = (p > 0) ? REAL_ATAN2(y, x) : 0;
+    real phi = REAL_ATAN2(z, p * (1 - GEOMAG_WGS84_E2));
+    real n = GEOMAG_WGS84_A;
+    for (int i = 0; i < 5; ++i) {
+        const real sin_phi = REAL_SIN(phi);
+        n = GEOMAG_WGS84_A / REAL_SQRT(1 - GEOMAG_WGS84_E2 * sin_phi * sin_phi);
+        phi = REAL_ATAN2(z + GEOMAG_WGS84_E2 * n * sin_phi, p);
+    }
+    const real sin_phi = REAL_SIN(phi);
+    n = GEOMAG_WGS84_A / REAL_SQRT(1 - GEOMAG_WGS84_E2 * sin_phi * sin_phi);
+    *lat = phi;
+    // Projection on the normal, well conditioned at the poles too
+    *height = p * REAL_COS(phi) + (z + GEOMAG_WGS84_E2 * n * sin_phi) * sin_phi - n;
+}
+
+void geomag_ned_frame(const real lat, const real lon, real (*ned)[3]) {
+    const real sin_lat = REAL_SIN(lat), cos_lat = REAL_COS(lat);
+    const real sin_lon = REAL_SIN(lon), cos_lon = REAL_COS(lon);
+    ned[0][0] = -sin_lat * cos_lon;
+    ned[0][1] = -sin_lat * sin_lon;
+    ned[0][2] = cos_lat;
+    ned[1][0] = -sin_lon;
+    ned[1][1] = cos_lon;
+    ned[1][2] = 0;
+    ned[2][0] = -cos_lat * cos_lon;
+    ned[2][1] = -cos_lat * sin_lon;
+    ned[2][2] = -sin_lat;
+}
+
+void geomag_eval_geodetic(
+    const struct geomag_model *model, const real dyear, const real (*lla)[3], real (*mag_ned)[3]
+) {
+    // The same sines and cosines place the position and rotate the field
+    const real sin_lat = REAL_SIN((*lla)[0]), cos_lat = REAL_COS((*lla)[0]);
+    const real sin_lon = REAL_SIN((*lla)[1]), cos_lon = REAL_COS((*lla)[1]);
+    real pos[3], mag[3];
+    geodetic_position(sin_lat, cos_lat, sin_lon, cos_lon, (*lla)[2], &pos);
+    geomag_eval(model, dyear, (const real (*)[3]) &pos, &mag);
+    const real mag_horiz = cos_lon * mag[0] + sin_lon * mag[1];
+    (*mag_ned)[0] = -sin_lat * mag_horiz + cos_lat * mag[2];
+    (*mag_ned)[1] = -sin_lon * mag[0] + cos_lon * mag[1];
+    (*mag_ned)[2] = -cos_lat * mag_horiz - sin_lat * mag[2];
+}
+
+void geomag_geodetic_batch(
+    const struct geomag_model *model, const size_t count, const real *dyear, const real (*lla)[3],
+    real (*mag_ned)[3]
+) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_eval_geodetic(model, dyear[i], &lla[i], &mag_ned[i]);
+    }
+}
+
+void geomag_elements(
+    const size_t count, const real (*lla)[3], const real (*mag_ned)[3], struct geomag_elements *elements
+) {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        const real x = mag_ned[i][0], y = mag_ned[i][1], z = mag_ned[i][2];
+        const real h = REAL_SQRT(x * x + y * y);
+        const real decl = REAL_ATAN2(y, x);
+        // Grid north follows the meridian towards the nearer pole
+        const real gv = decl - ((lla[i][0] >= 0) ? lla[i][1] : -lla[i][1]);
+        elements[i].decl = decl;
+        elements[i].incl = REAL_ATAN2(z, h);
+        elements[i].h = h;
+        elements[i].f = REAL_SQRT(h * h + z * z);
+        elements[i].gv = gv + 2 * PI * REAL_FLOOR((PI - gv) / (2 * PI));
+    }
 }
 
-static const struct WMM_COEFF_SET WMM_COEFFS[] = {
+void geomag_elements_batch(
+    const struct geomag_model *model, const size_t count, const real *dyear, const real (*lla)[3],
+    struct geomag_elements *elements
+) {
+    const size_t num_blocks = (count + ELEMENTS_BLOCK - 1) / ELEMENTS_BLOCK;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t b = 0; b < num_blocks; ++b) {
+        const size_t start = b * ELEMENTS_BLOCK;
+        const size_t len = (count - start < ELEMENTS_BLOCK) ? count - start : ELEMENTS_BLOCK;
+        real mag_ned[ELEMENTS_BLOCK][3];
+        for (size_t i = 0; i < len; ++i) {
+            geomag_eval_geodetic(model, dyear[start + i], &lla[start + i], &mag_ned[i]);
+        }
+        geomag_elements(len, &lla[start], (const real (*)[3]) mag_ned, &elements[start]);
+    }
+}
+
+void geomag_grid_row(
+    const struct geomag_model *model, const real dyear, const real lat, const real height, const size_t num_lons,
+    const real *lons, real (*mag_itrf)[3]
+) {
+    // Longitude rotates basis order m by e^{i m dlon}, and the field is linear
+    // in the basis, so along a row the field is a Fourier series in longitude
+    // F(lon) = sum a_m cos(m lon) + b_m sin(m lon), with a_m the field of the
+    // order m terms at longitude 0 and b_m that of the terms turned by 90 / m
+    // degrees, (V, W) -> (-W, V)
+    const real t = dyear - model->epoch;
+    real pos[3];
+    struct geomag_basis basis;
+    geodetic_position(REAL_SIN(lat), REAL_COS(lat), 0, 1, height, &pos);
+    geomag_basis((const real (*)[3]) &pos, &basis);
+    real a[WMM_NMAX + 2][3], b[WMM_NMAX + 2][3];
+    for (int m = 0; m <= WMM_NMAX + 1; ++m) {
+        real pa[3] = {0, 0, 0}, pb[3] = {0, 0, 0};
+        for (int n = m; n <= WMM_NMAX + 1; ++n) {
+            const int idx = calc_basis_index(n, m);
+            accumulate(model, n, m, t, basis.V[idx], basis.W[idx], &pa[0], &pa[1], &pa[2]);
+            accumulate(model, n, m, t, -basis.W[idx], basis.V[idx], &pb[0], &pb[1], &pb[2]);
+        }
+        store_field(pa[0], pa[1], pa[2], &a[m]);
+        store_field(pb[0], pb[1], pb[2], &b[m]);
+    }
+
+    for (size_t i = 0; i < num_lons; ++i) {
+        const real cos_lon = REAL_COS(lons[i]), sin_lon = REAL_SIN(lons[i]);
+        real cos_m = 1, sin_m = 0;
+        real f[3] = {0, 0, 0};
+        for (int m = 0; m <= WMM_NMAX + 1; ++m) {
+            for (int k = 0; k < 3; ++k) {
+                f[k] += a[m][k] * cos_m + b[m][k] * sin_m;
+            }
+            const real prev_cos_m = cos_m;
+            cos_m = cos_m * cos_lon - sin_m * sin_lon;
+            sin_m = sin_m * cos_lon + prev_cos_m * sin_lon;
+        }
+        mag_itrf[i][0] = f[0];
+        mag_itrf[i][1] = f[1];
+        mag_itrf[i][2] = f[2];
+    }
+}
+
+void geomag_grid(
+    const struct geomag_model *model, const real dyear, const size_t num_heights, const real *heights,
+    const size_t num_lats, const real *lats, const size_t num_lons, const real *lons, real (*mag_itrf)[3]
+) {
+    const size_t num_rows = num_heights * num_lats;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t row = 0; row < num_rows; ++row) {
+        geomag_grid_row(
+            model, dyear, lats[row % num_lats], heights[row / num_lats], num_lons, lons, &mag_itrf[row * num_lons]
+        );
+    }
+}
+
+const struct geomag_model WMM2020 = {
     // Generated via WMM 2020 COF file
-    {                     0.0,                     0.0,                     0.0,                     0.0 },
-    {                -29404.5,                     0.0,                     6.7,                     0.0 },
-    {                 -2500.0,                     0.0,                   -11.5,                     0.0 },
-    {                  1363.9,                     0.0,                     2.8,                     0.0 },
-    {                   903.1,                     0.0,                    -1.1,                     0.0 },
-    {                  -234.4,                     0.0,                    -0.3,                     0.0 },
-    {                    65.9,                     0.0,                    -0.6,                     0.0 },
-    {                    80.6,                     0.0,                    -0.1,                     0.0 },
-    {                    23.6,                     0.0,                    -0.1,                     0.0 },
-    {                     5.0,                     0.0,                    -0.1,                     0.0 },
-    {                    -1.9,                     0.0,                     0.0,                     0.0 },
-    {                     3.0,                     0.0,                    -0.0,                     0.0 },
-    {                    -2.0,                     0.0,                     0.0,                     0.0 },
-    {                 -1450.7,                  4652.9,                     7.7,                   -25.1 },
-    {       1721.658502723464,     -1727.2010653076843,      -4.099186911246343,     -17.435978129526696 },
-    {      -972.0391795944579,      -33.55800947612954,     -2.5311394008759507,       2.327015255644019 },
-    {      255.95475381402863,        89.1762300167483,     -0.5059644256269408,      0.0632455532033676 },
-    {        93.7520168671942,      12.316087040939586,     0.15491933384829665,    0.025819888974716113 },
-    {      14.315093599481099,      -4.167961703507454,    -0.08728715609439695,     0.02182178902359924 },
-    {     -14.513835763554324,      -9.713686956337138,    -0.05669467095138408,      0.0944911182523068 },
-    {      1.6333333333333333,                     1.4,    0.016666666666666666,   -0.049999999999999996 },
-    {       1.222383827699885,     -3.4733589250496735,     -0.0298142396999972,   -0.044721359549995794 },
-    {     -0.8360078294544202,      0.4584559064750046,                    -0.0,                    -0.0 },
-    {    -0.17232808737106584,                    -0.0,   -0.012309149097933274,                    -0.0 },
-    {   -0.011322770341445958,     -0.1358732440973515,                    -0.0,                    -0.0 },
-    {       484.0504656885822,      -212.1184889002685,     -0.6350852961085883,      -6.899335716816027 },
-    {      159.59273375272028,       31.21624577043178,     0.43893811257017384,    -0.12909944487358055 },
-    {       6.424968655349396,      -11.80643892119889,      -0.447213595499958,      0.5142956348249517 },
-    {       9.163701684986728,      10.168878760123716,   -0.034156502553198666,     0.12198750911856666 },
-    {       2.518739291599593,      0.8625819491779427,    0.017251638983558856,   -0.062105900340811884 },
-    {    -0.21345296744756048,    -0.43204937989385733,  -0.0025717224993681985,     0.01543033499620919 },
-    {    -0.34860834438919813,     -0.3047832953802704,  -0.0019920476822239894,    0.013944333775567924 },
-    {     0.04608402514687029,     0.17639057901043456,                    -0.0,    0.003178208630818641 },
-    {   -0.001297498240269205,    -0.00259499648053841,                    -0.0,    0.001297498240269205 },
-    {   -0.026989594817970655,    0.028069178610689485,                    -0.0,   0.0010795837927188264 },
-    {   0.0045620741787613245,   0.0045620741787613245,                    -0.0,                     0.0 },
-    {      27.706822765841952,     -28.613342361756885,     -0.6429964575675704,     0.05797509043642029 },
-    {      -6.163395528801023,       3.980111269083531,     0.10757057484009544,     0.07370576424228761 },
-    {     -1.4014055444445763,     -1.2081769192688496,   0.0009960238411119947,   -0.008964214570007952 },
-    {     -0.6986913788341337,     0.30305379147785055,    0.008050764858994133,   -0.008050764858994133 },
-    {      0.2054885133055595,     0.00836501912571304,   0.0025458753860865776,  -0.0025458753860865776 },
-    {  -0.0009808164772274995,    0.031386127271279984,   0.0012260205965343744,  -0.0004904082386137498 },
-    {    -0.00242739693751473,    0.016991778562603112,   0.0006935419821470658,  -0.0006935419821470658 },
-    {    0.002162912891956627,    0.004453055954028349,   0.0002544603402301914,  -0.0003816905103452871 },
-    {   0.0023082472415244704,  -0.0004808848419842647,                     0.0,                     0.0 },
-    {   0.0009684786719132941,   0.0009684786719132941,                     0.0,   -7.44983593779457e-05 },
-    {      0.3373574066791329,     -2.4657375381704476,    -0.03873623667505701,    -0.03944053188733077 },
-    {    -0.35496478698597694,     0.07559435278405066,   0.0028171808490950554,   0.0070429521227376385 },
-    {   -0.038006427563705626,    -0.06761364461609509,   -0.001469861839480328,    0.000944911182523068 },
-    {    0.008663030650303626,     0.01288488735962881,  0.00010965861582662818, -0.00010965861582662818 },
-    {   -0.006679356009162114,  -0.0037353744506214664, -3.1655715683232764e-05,  0.00015827857841616382 },
-    { -0.00021595245611506707,   -0.001001234114715311, -5.8896124395018286e-05,    7.85281658600244e-05 },
-    {  -0.0001156696920770171,   0.0006169050244107579, -1.2852188008557456e-05,  1.2852188008557456e-05 },
-    {  -7.901744265512675e-05,  -3.511886340227856e-05,                    -0.0,   1.755943170113928e-05 },
-    {   -7.44983593779457e-05, -0.00011174753906691856,                    -0.0,   6.208196614828809e-06 },
-    {     0.01017077503944504,     0.07357108075978126,   0.0007423923386456233,  0.00037119616932281165 },
-    {   0.0030218361150951764,    0.002014557410063451,                    -0.0,  2.2383971222927232e-05 },
-    {   0.0005848459510753503, -0.00020104079568215166,  -4.569108992776174e-05, -0.00010965861582662816 },
-    {   0.0006716482625685774,   0.0006540888308674382,   1.755943170113928e-05, -1.3169573775854458e-05 },
-    {  -0.0003120815423275714,  -0.0001454816212354092,                    -0.0,   2.346477761861439e-06 },
-    {   8.128437404749033e-06, -0.00011650760280140282, -2.7094791349163448e-06, -2.7094791349163448e-06 },
-    {   2.488815505973484e-06,   4.977631011946968e-06,  -8.296051686578281e-07,                    -0.0 },
-    {  3.7264392750537873e-06,   5.323484678648268e-07,                    -0.0,                    -0.0 },
-    {   -0.004180717250887574,    0.004400414911676101,   5.169356724435949e-05,   6.461695905544936e-05 },
-    {  -0.0001290349435231273, -0.00048746534219848084, -1.4337215947014143e-05,  3.5843039867535357e-06 },
-    {    9.27996603708848e-05,  2.4385312214247102e-05,  3.3868489186454308e-06, -3.3868489186454308e-06 },
-    {   3.332218741109649e-06,  2.3628460164232055e-05,   9.087869293935405e-07,                    -0.0 },
-    { -1.3631803940903108e-06, -1.5146448823225676e-07,                    -0.0,  1.5146448823225676e-07 },
-    {  -5.750020635711086e-07, -1.6428630387745962e-07,                     0.0,                     0.0 },
-    {  1.4227611265172995e-07,  3.3197759618736983e-07,                     0.0,                     0.0 },
-    {  4.6939331209678796e-05,  -9.100482581468336e-06,  4.7897276744570195e-06,  1.4369183023371058e-06 },
-    { -2.0405589067644898e-05,  -8.533246337378777e-06,                     0.0,   4.946809470944218e-07 },
-    {   3.891438805883525e-06,  1.7489612610712472e-07,                    -0.0,  -8.744806305356236e-08 },
-    {   3.489875760800776e-07,  -7.714462208085927e-07,  -1.836776716210935e-08,                    -0.0 },
-    {  -8.658648477055405e-09, -1.4719702410994188e-07,                    -0.0,   8.658648477055405e-09 },
-    {  2.2208964739434834e-08,  -4.441792947886967e-09,                    -0.0,                    -0.0 },
-    {  -9.275267758020409e-08,    8.65691657415238e-07,  1.2367023677360544e-07,   3.091755919340136e-08 },
-    {  -6.973706875519563e-07, -1.1247914315354133e-07,                    -0.0,   3.749304771784711e-08 },
-    {   3.499351120332397e-08,  -8.498424149378678e-08,  -4.999073029046282e-09,  -2.499536514523141e-09 },
-    {  1.3905011362836212e-08, -1.5891441557527103e-08,   -9.93215097345444e-10,                    -0.0 },
-    {  -8.883585895773934e-10,    2.66507576873218e-09,                     0.0,   4.441792947886967e-10 },
-    {  -2.103252670898813e-07,  1.7144160426654187e-07,    -7.0697568769708e-09,     3.5348784384854e-09 },
-    {   -9.73148077330024e-09,  -4.054783655541767e-10,  -4.054783655541767e-10,   8.109567311083534e-10 },
-    {  -7.693411062441365e-10,  -3.846705531220682e-09,  -1.282235177073561e-10,  -1.282235177073561e-10 },
-    { -2.4231967148825077e-10,   9.692786859530031e-11,                    -0.0,                    -0.0 },
-    {  -3.536041036260129e-09,  -7.978759261304907e-09,                    -0.0,                    -0.0 },
-    {   3.957063665233731e-11,  -3.957063665233731e-10, -1.9785318326168656e-11,                     0.0 },
-    {    5.96549793142218e-12, -5.3689481382799615e-11,                    -0.0,                    -0.0 },
-    {   1.307655652543513e-10, -1.0967434505203656e-10,  -4.218244040462945e-12,                    -0.0 },
-    {  -9.675211528915663e-12,                    -0.0,                    -0.0,                     0.0 },
-    {  -5.386211681667379e-13,   8.977019469445631e-13, -1.7954038938891263e-13, -1.7954038938891263e-13 }
+    2020,
+    {
+        {                     0.0,                     0.0,                     0.0,                     0.0 },
+        {                -29404.5,                     0.0,                     6.7,                     0.0 },
+        {                 -2500.0,                     0.0,                   -11.5,                     0.0 },
+        {                  1363.9,                     0.0,                     2.8,                     0.0 },
+        {                   903.1,                     0.0,                    -1.1,                     0.0 },
+        {                  -234.4,                     0.0,                    -0.3,                     0.0 },
+        {                    65.9,                     0.0,                    -0.6,                     0.0 },
+        {                    80.6,                     0.0,                    -0.1,                     0.0 },
+        {                    23.6,                     0.0,                    -0.1,                     0.0 },
+        {                     5.0,                     0.0,                    -0.1,                     0.0 },
+        {                    -1.9,                     0.0,                     0.0,                     0.0 },
+        {                     3.0,                     0.0,                    -0.0,                     0.0 },
+        {                    -2.0,                     0.0,                     0.0,                     0.0 },
+        {                 -1450.7,                  4652.9,                     7.7,                   -25.1 },
+        {       1721.658502723464,     -1727.2010653076843,      -4.099186911246343,     -17.435978129526696 },
+        {      -972.0391795944579,      -33.55800947612954,     -2.5311394008759507,       2.327015255644019 },
+        {      255.95475381402863,        89.1762300167483,     -0.5059644256269408,      0.0632455532033676 },
+        {        93.7520168671942,      12.316087040939586,     0.15491933384829665,    0.025819888974716113 },
+        {      14.315093599481099,      -4.167961703507454,    -0.08728715609439695,     0.02182178902359924 },
+        {     -14.513835763554324,      -9.713686956337138,    -0.05669467095138408,      0.0944911182523068 },
+        {      1.6333333333333333,                     1.4,    0.016666666666666666,   -0.049999999999999996 },
+        {       1.222383827699885,     -3.4733589250496735,     -0.0298142396999972,   -0.044721359549995794 },
+        {     -0.8360078294544202,      0.4584559064750046,                    -0.0,                    -0.0 },
+        {    -0.17232808737106584,                    -0.0,   -0.012309149097933274,                    -0.0 },
+        {   -0.011322770341445958,     -0.1358732440973515,                    -0.0,                    -0.0 },
+        {       484.0504656885822,      -212.1184889002685,     -0.6350852961085883,      -6.899335716816027 },
+        {      159.59273375272028,       31.21624577043178,     0.43893811257017384,    -0.12909944487358055 },
+        {       6.424968655349396,      -11.80643892119889,      -0.447213595499958,      0.5142956348249517 },
+        {       9.163701684986728,      10.168878760123716,   -0.034156502553198666,     0.12198750911856666 },
+        {       2.518739291599593,      0.8625819491779427,    0.017251638983558856,   -0.062105900340811884 },
+        {    -0.21345296744756048,    -0.43204937989385733,  -0.0025717224993681985,     0.01543033499620919 },
+        {    -0.34860834438919813,     -0.3047832953802704,  -0.0019920476822239894,    0.013944333775567924 },
+        {     0.04608402514687029,     0.17639057901043456,                    -0.0,    0.003178208630818641 },
+        {   -0.001297498240269205,    -0.00259499648053841,                    -0.0,    0.001297498240269205 },
+        {   -0.026989594817970655,    0.028069178610689485,                    -0.0,   0.0010795837927188264 },
+        {   0.0045620741787613245,   0.0045620741787613245,                    -0.0,                     0.0 },
+        {      27.706822765841952,     -28.613342361756885,     -0.6429964575675704,     0.05797509043642029 },
+        {      -6.163395528801023,       3.980111269083531,     0.10757057484009544,     0.07370576424228761 },
+        {     -1.4014055444445763,     -1.2081769192688496,   0.0009960238411119947,   -0.008964214570007952 },
+        {     -0.6986913788341337,     0.30305379147785055,    0.008050764858994133,   -0.008050764858994133 },
+        {      0.2054885133055595,     0.00836501912571304,   0.0025458753860865776,  -0.0025458753860865776 },
+        {  -0.0009808164772274995,    0.031386127271279984,   0.0012260205965343744,  -0.0004904082386137498 },
+        {    -0.00242739693751473,    0.016991778562603112,   0.0006935419821470658,  -0.0006935419821470658 },
+        {    0.002162912891956627,    0.004453055954028349,   0.0002544603402301914,  -0.0003816905103452871 },
+        {   0.0023082472415244704,  -0.0004808848419842647,                     0.0,                     0.0 },
+        {   0.0009684786719132941,   0.0009684786719132941,                     0.0,   -7.44983593779457e-05 },
+        {      0.3373574066791329,     -2.4657375381704476,    -0.03873623667505701,    -0.03944053188733077 },
+        {    -0.35496478698597694,     0.07559435278405066,   0.0028171808490950554,   0.0070429521227376385 },
+        {   -0.038006427563705626,    -0.06761364461609509,   -0.001469861839480328,    0.000944911182523068 },
+        {    0.008663030650303626,     0.01288488735962881,  0.00010965861582662818, -0.00010965861582662818 },
+        {   -0.006679356009162114,  -0.0037353744506214664, -3.1655715683232764e-05,  0.00015827857841616382 },
+        { -0.00021595245611506707,   -0.001001234114715311, -5.8896124395018286e-05,    7.85281658600244e-05 },
+        {  -0.0001156696920770171,   0.0006169050244107579, -1.2852188008557456e-05,  1.2852188008557456e-05 },
+        {  -7.901744265512675e-05,  -3.511886340227856e-05,                    -0.0,   1.755943170113928e-05 },
+        {   -7.44983593779457e-05, -0.00011174753906691856,                    -0.0,   6.208196614828809e-06 },
+        {     0.01017077503944504,     0.07357108075978126,   0.0007423923386456233,  0.00037119616932281165 },
+        {   0.0030218361150951764,    0.002014557410063451,                    -0.0,  2.2383971222927232e-05 },
+        {   0.0005848459510753503, -0.00020104079568215166,  -4.569108992776174e-05, -0.00010965861582662816 },
+        {   0.0006716482625685774,   0.0006540888308674382,   1.755943170113928e-05, -1.3169573775854458e-05 },
+        {  -0.0003120815423275714,  -0.0001454816212354092,                    -0.0,   2.346477761861439e-06 },
+        {   8.128437404749033e-06, -0.00011650760280140282, -2.7094791349163448e-06, -2.7094791349163448e-06 },
+        {   2.488815505973484e-06,   4.977631011946968e-06,  -8.296051686578281e-07,                    -0.0 },
+        {  3.7264392750537873e-06,   5.323484678648268e-07,                    -0.0,                    -0.0 },
+        {   -0.004180717250887574,    0.004400414911676101,   5.169356724435949e-05,   6.461695905544936e-05 },
+        {  -0.0001290349435231273, -0.00048746534219848084, -1.4337215947014143e-05,  3.5843039867535357e-06 },
+        {    9.27996603708848e-05,  2.4385312214247102e-05,  3.3868489186454308e-06, -3.3868489186454308e-06 },
+        {   3.332218741109649e-06,  2.3628460164232055e-05,   9.087869293935405e-07,                    -0.0 },
+        { -1.3631803940903108e-06, -1.5146448823225676e-07,                    -0.0,  1.5146448823225676e-07 },
+        {  -5.750020635711086e-07, -1.6428630387745962e-07,                     0.0,                     0.0 },
+        {  1.4227611265172995e-07,  3.3197759618736983e-07,                     0.0,                     0.0 },
+        {  4.6939331209678796e-05,  -9.100482581468336e-06,  4.7897276744570195e-06,  1.4369183023371058e-06 },
+        { -2.0405589067644898e-05,  -8.533246337378777e-06,                     0.0,   4.946809470944218e-07 },
+        {   3.891438805883525e-06,  1.7489612610712472e-07,                    -0.0,  -8.744806305356236e-08 },
+        {   3.489875760800776e-07,  -7.714462208085927e-07,  -1.836776716210935e-08,                    -0.0 },
+        {  -8.658648477055405e-09, -1.4719702410994188e-07,                    -0.0,   8.658648477055405e-09 },
+        {  2.2208964739434834e-08,  -4.441792947886967e-09,                    -0.0,                    -0.0 },
+        {  -9.275267758020409e-08,    8.65691657415238e-07,  1.2367023677360544e-07,   3.091755919340136e-08 },
+        {  -6.973706875519563e-07, -1.1247914315354133e-07,                    -0.0,   3.749304771784711e-08 },
+        {   3.499351120332397e-08,  -8.498424149378678e-08,  -4.999073029046282e-09,  -2.499536514523141e-09 },
+        {  1.3905011362836212e-08, -1.5891441557527103e-08,   -9.93215097345444e-10,                    -0.0 },
+        {  -8.883585895773934e-10,    2.66507576873218e-09,                     0.0,   4.441792947886967e-10 },
+        {  -2.103252670898813e-07,  1.7144160426654187e-07,    -7.0697568769708e-09,     3.5348784384854e-09 },
+        {   -9.73148077330024e-09,  -4.054783655541767e-10,  -4.054783655541767e-10,   8.109567311083534e-10 },
+        {  -7.693411062441365e-10,  -3.846705531220682e-09,  -1.282235177073561e-10,  -1.282235177073561e-10 },
+        { -2.4231967148825077e-10,   9.692786859530031e-11,                    -0.0,                    -0.0 },
+        {  -3.536041036260129e-09,  -7.978759261304907e-09,                    -0.0,                    -0.0 },
+        {   3.957063665233731e-11,  -3.957063665233731e-10, -1.9785318326168656e-11,                     0.0 },
+        {    5.96549793142218e-12, -5.3689481382799615e-11,                    -0.0,                    -0.0 },
+        {   1.307655652543513e-10, -1.0967434505203656e-10,  -4.218244040462945e-12,                    -0.0 },
+        {  -9.675211528915663e-12,                    -0.0,                    -0.0,                     0.0 },
+        {  -5.386211681667379e-13,   8.977019469445631e-13, -1.7954038938891263e-13, -1.7954038938891263e-13 }
+    }
 };
@@ -26,12 +26,110 @@ SOFTWARE.
 #ifndef GEOMAG_H
 #define GEOMAG_H
 
+#include <stddef.h>
+
 // Can fiddle around with if needed
 typedef double real;
 #define REAL_SQRT sqrt
+#define REAL_SIN sin
+#define REAL_COS cos
+#define REAL_POW pow
+#define REAL_FABS fabs
+#define REAL_FLOOR floor
+#define REAL_ATAN2 atan2
 #define REAL_HALF 0.5
 #define REAL_NT2T 1e-9
 
+// Model order
+#define WMM_NMAX 12
+
+// Number of coefficients
+#define WMM_TOT_COEFFS ((WMM_NMAX + 1) * (WMM_NMAX + 2) / 2)
+
+// WGS 84 semi-major axis [m] and first eccentricity squared
+#define GEOMAG_WGS84_A 6378137.0
+#define GEOMAG_WGS84_E2 6.69437999014e-3
+
+// Coefficients of one degree and order, un-Schmidt-normalized [nT], [nT/yr]
+struct WMM_COEFF_SET {
+    real main_field_c, main_field_s;
+    real sec_var_c, sec_var_s;
+};
+
+// Magnetic field model.
+//
+// Coefficients are indexed by `m * (2 * WMM_NMAX - m + 1) / 2 + n`, the
+// same layout as `wmmcodeupdate.py` generates.
+struct geomag_model {
+    // Epoch of model in decimal year
+    real epoch;
+    struct WMM_COEFF_SET coeffs[WMM_TOT_COEFFS];
+};
+
+// WMM 2020 (World Magnetic Model - 2020), used by `geomag`
+extern const struct geomag_model WMM2020;
+
+// Magnetic field and its spatial derivatives at a position
+struct geomag_jet {
+    // Magnetic field vector in ITRF frame [T]
+    real mag[3];
+    // Rate of change of `mag` from secular variation [T/yr]
+    real mag_rate[3];
+    // Gradient, grad[i][j] = dB_i/dx_j in ITRF frame [T/m]
+    real grad[3][3];
+    // Hessian, hess[i][j][k] = d2B_i/dx_j dx_k in ITRF frame [T/m^2]
+    real hess[3][3][3];
+};
+
+// Number of design matrix columns, a cosine and sine term per coefficient
+#define GEOMAG_DESIGN_COLS (2 * WMM_TOT_COEFFS)
+
+// Number of basis terms, which run one degree past the model order
+#define GEOMAG_BASIS_LEN ((WMM_NMAX + 2) * (WMM_NMAX + 3) / 2)
+
+// Magnetic elements at a geodetic position
+struct geomag_elements {
+    // Declination, east of true north [rad]
+    real decl;
+    // Inclination, positive down [rad]
+    real incl;
+    // Horizontal intensity [T]
+    real h;
+    // Total intensity [T]
+    real f;
+    // Grid variation, declination relative to grid north of a polar
+    // stereographic grid, in (-pi, pi]. Only meaningful above 55 degrees of
+    // latitude, where north and south grids are used. [rad]
+    real gv;
+};
+
+// Frame of output field vectors
+enum geomag_frame {
+    // Earth fixed x, y, z
+    GEOMAG_FRAME_ITRF,
+    // Local WGS 84 geodetic north, east, down
+    GEOMAG_FRAME_NED,
+    // Local WGS 84 geodetic east, north, up
+    GEOMAG_FRAME_ENU,
+    // Geocentric spherical radial, colatitude and longitude components,
+    // B_r, B_theta, B_phi, with B_theta positive southwards
+    GEOMAG_FRAME_SPHERICAL,
+    // Inertial, ITRF rotated by Greenwich mean sidereal time only, so
+    // precession, nutation and polar motion are neglected
+    GEOMAG_FRAME_ECI,
+    // Body frame, from the ECI frame and a per-sample attitude quaternion
+    GEOMAG_FRAME_BODY
+};
+
+// Spherical harmonic basis V_nm, W_nm at a position.
+//
+// Depends only on position, so can be computed once and then contracted
+// with the coefficients at any number of epochs.
+struct geomag_basis {
+    real V[GEOMAG_BASIS_LEN];
+    real W[GEOMAG_BASIS_LEN];
+};
+
 // Returns magnetic field vector in ITRF.
 //
 // Uses WMM 2020 (World Magnetic Model - 2020).
@@ -44,4 +142,419 @@ typedef double real;
 //     mag_itrf: Magnetic field vector in ITRF frame [T]
 void geomag(real dyear, const real (*pos_itrf)[3], real (*mag_itrf)[3]);
 
+// Returns magnetic field vector in ITRF using the given model.
+//
+// Args:
+//     model: Magnetic field model, such as `WMM2020`
+//     dyear: Decimal year
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//
+// Returns:
+//     mag_itrf: Magnetic field vector in ITRF frame [T]
+void geomag_eval(const struct geomag_model *model, real dyear, const real (*pos_itrf)[3], real (*mag_itrf)[3]);
+
+// Returns magnetic field vector and its derivatives in ITRF.
+//
+// Derivatives are analytic, from the same recurrence run one degree further
+// per derivative. The field is curl and divergence free, so `grad` is
+// symmetric and trace free, and `hess` is symmetric in all indices.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//     order: 0 for `mag` and `mag_rate` only, 1 to add `grad`, 2 to add `hess`,
+//         clamped to [0, 2]
+//
+// Returns:
+//     jet: Field and derivatives up to `order`, the rest is left untouched
+void geomag_jet(
+    const struct geomag_model *model, real dyear, const real (*pos_itrf)[3], int order, struct geomag_jet *jet
+);
+
+// Computes the design matrix rows at a position.
+//
+// The field is linear in the coefficients, so the field at `pos_itrf` is the
+// product of these rows with the coefficient vector from
+// `geomag_model_coeffs`. Column `2 * idx` multiplies the cosine coefficient
+// at index `idx` and column `2 * idx + 1` the sine coefficient.
+//
+// Args:
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//
+// Returns:
+//     design: Rows for the x, y and z field components [T/nT]
+void geomag_design(const real (*pos_itrf)[3], real (*design)[GEOMAG_DESIGN_COLS]);
+
+// Computes the design matrix rows for a batch of positions.
+//
+// Args:
+//     count: Number of positions
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//
+// Returns:
+//     design: `3 * count` rows, three per position as in `geomag_design`
+void geomag_design_batch(size_t count, const real (*pos_itrf)[3], real (*design)[GEOMAG_DESIGN_COLS]);
+
+// Writes the coefficients of a model at an epoch as a design matrix column.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     stride: Distance between consecutive entries, e.g. the number of
+//         columns of the coefficient matrix being filled in
+//
+// Returns:
+//     coeffs: `GEOMAG_DESIGN_COLS` entries, `stride` apart [nT]
+void geomag_model_coeffs(const struct geomag_model *model, real dyear, real *coeffs, size_t stride);
+
+// Multiplies design matrix rows by a matrix of coefficient columns.
+//
+// Evaluates an ensemble of `k` coefficient sets at once, as one cache
+// blocked matrix product. Row blocks are split across threads when compiled
+// with OpenMP.
+//
+// Args:
+//     rows: Number of design matrix rows
+//     k: Number of coefficient sets
+//     design: Design matrix rows from `geomag_design_batch`
+//     coeffs: Row-major `GEOMAG_DESIGN_COLS` by `k` coefficient matrix [nT]
+//
+// Returns:
+//     mag: Row-major `rows` by `k` matrix of field components [T]
+void geomag_design_product(
+    size_t rows, size_t k, const real (*design)[GEOMAG_DESIGN_COLS], const real *coeffs, real *mag
+);
+
+// Loads a model from the text of a WMM `.COF` file.
+//
+// Degrees above `WMM_NMAX` are ignored.
+//
+// Args:
+//     text: Null-terminated contents of the `.COF` file
+//
+// Returns:
+//     model: Loaded model
+//     0 on success, -1 if `text` is malformed, or misses or repeats a coefficient
+int geomag_model_parse_cof(const char *text, struct geomag_model *model);
+
+// Writes a model as the text of a WMM `.COF` file.
+//
+// Coefficients are Schmidt-normalized and rounded to 0.1 nT as in the WMM
+// releases. Like `snprintf`, the text is truncated to fit `size`.
+//
+// Args:
+//     model: Model to write
+//     name: Model name for the header line, e.g. "WMM-2020"
+//     date: Release date for the header line, e.g. "12/10/2019"
+//     size: Size of `text` in bytes
+//
+// Returns:
+//     text: Null-terminated contents of the `.COF` file
+//     Length of the full text, or -1 on an encoding error
+int geomag_model_write_cof(
+    const struct geomag_model *model, const char *name, const char *date, char *text, size_t size
+);
+
+// Returns magnetic field vectors in ITRF for a batch of positions.
+//
+// Each position has its own epoch, so samples from an ephemeris can be
+// evaluated in one call without grouping them by time. Samples are split
+// across threads when compiled with OpenMP.
+//
+// Args:
+//     model: Magnetic field model
+//     count: Number of positions
+//     dyear: Decimal year of each position
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//
+// Returns:
+//     mag_itrf: Magnetic field vectors in ITRF frame [T]
+void geomag_batch(
+    const struct geomag_model *model, size_t count, const real *dyear,
+    const real (*pos_itrf)[3], real (*mag_itrf)[3]
+);
+
+// Returns magnetic field vectors in a chosen frame for a batch of positions.
+//
+// Each vector is rotated as it is stored, so there is no second pass over
+// the output.
+//
+// Args:
+//     model: Magnetic field model
+//     count: Number of positions
+//     dyear: Decimal year of each position, as UTC for the ECI and body frames
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//     frame: Output frame
+//     quat: Attitude of each sample for `GEOMAG_FRAME_BODY`, otherwise
+//         unused and may be NULL. Unit quaternions w, x, y, z rotating body
+//         vectors into the ECI frame.
+//
+// Returns:
+//     mag_out: Magnetic field vectors in the output frame [T]
+void geomag_batch_frame(
+    const struct geomag_model *model, size_t count, const real *dyear, const real (*pos_itrf)[3],
+    enum geomag_frame frame, const real (*quat)[4], real (*mag_out)[3]
+);
+
+// Returns magnetic field vectors for a batch of samples in the caller's
+// memory layout.
+//
+// Each array is addressed by a byte stride, so positions can be read from
+// and fields written into arrays of structs in place, with no copies. A
+// sample's three components must be contiguous. Otherwise behaves like
+// `geomag_batch_frame`.
+//
+// Args:
+//     model: Magnetic field model
+//     count: Number of samples
+//     dyear: Decimal year of the first sample
+//     dyear_stride: Bytes between decimal years, 0 to use one for all samples
+//     pos_itrf: First ECEF position vector in ITRF frame [m]
+//     pos_stride: Bytes between position vectors
+//     frame: Output frame
+//     quat: First attitude quaternion for `GEOMAG_FRAME_BODY`, as in
+//         `geomag_batch_frame`, otherwise unused and may be NULL
+//     quat_stride: Bytes between quaternions
+//     mag_stride: Bytes between field vectors
+//
+// Returns:
+//     mag_out: First magnetic field vector in the output frame [T]
+void geomag_batch_strided(
+    const struct geomag_model *model, size_t count, const real *dyear, size_t dyear_stride,
+    const real *pos_itrf, size_t pos_stride, enum geomag_frame frame, const real *quat, size_t quat_stride,
+    real *mag_out, size_t mag_stride
+);
+
+// Returns Greenwich mean sidereal time at a decimal year.
+//
+// Uses the IAU 1982 expression and takes UT1 as UTC, which is good to about
+// 1e-5 rad. The fraction of the year is in days of that calendar year.
+//
+// Args:
+//     dyear: Decimal year, UTC
+//
+// Returns:
+//     Greenwich mean sidereal time in [0, 2 pi) [rad]
+real geomag_gmst(real dyear);
+
+// Computes the spherical harmonic basis at a position.
+//
+// Args:
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//
+// Returns:
+//     basis: Basis at `pos_itrf`
+void geomag_basis(const real (*pos_itrf)[3], struct geomag_basis *basis);
+
+// Computes the spherical harmonic basis for a batch of positions.
+//
+// Args:
+//     count: Number of positions
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//
+// Returns:
+//     basis: Basis at each position
+void geomag_basis_batch(size_t count, const real (*pos_itrf)[3], struct geomag_basis *basis);
+
+// Rotates a basis in longitude, without redoing the recurrence.
+//
+// Each order m is multiplied by e^{i m dlon}, so the result is the basis at
+// the position rotated by `dlon` about the ITRF z-axis. For a point fixed in
+// inertial space, `dlon` is minus the Earth rotation angle elapsed since
+// `basis` was computed. `basis` and `rotated` may be the same.
+//
+// Args:
+//     basis: Basis to rotate
+//     dlon: Eastward longitude rotation [rad]
+//
+// Returns:
+//     rotated: Rotated basis
+void geomag_basis_rotate(const struct geomag_basis *basis, real dlon, struct geomag_basis *rotated);
+
+// Returns magnetic field vector in ITRF from a precomputed basis.
+//
+// Same result as `geomag` at the position the basis was computed for.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     basis: Basis from `geomag_basis` or `geomag_basis_rotate`
+//
+// Returns:
+//     mag_itrf: Magnetic field vector in ITRF frame [T]
+void geomag_basis_field(
+    const struct geomag_model *model, real dyear, const struct geomag_basis *basis, real (*mag_itrf)[3]
+);
+
+// Returns magnetic field vectors in ITRF from a batch of precomputed bases.
+//
+// Bases from `geomag_basis_batch` can be contracted with any number of
+// models this way, without recomputing them.
+//
+// Args:
+//     model: Magnetic field model
+//     count: Number of bases
+//     dyear: Decimal year of each basis
+//     basis: Bases from `geomag_basis_batch`
+//
+// Returns:
+//     mag_itrf: Magnetic field vectors in ITRF frame [T]
+void geomag_basis_field_batch(
+    const struct geomag_model *model, size_t count, const real *dyear,
+    const struct geomag_basis *basis, real (*mag_itrf)[3]
+);
+
+// Converts WGS 84 geodetic coordinates to an ITRF position.
+//
+// Args:
+//     lat: Geodetic latitude [rad]
+//     lon: Longitude [rad]
+//     height: Height above the ellipsoid [m]
+//
+// Returns:
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+void geomag_geodetic_to_itrf(real lat, real lon, real height, real (*pos_itrf)[3]);
+
+// Converts an ITRF position to WGS 84 geodetic coordinates.
+//
+// Iterates Bowring's formula, which is accurate to well under a millimetre
+// anywhere from the centre of the Earth out past geostationary orbit.
+//
+// Args:
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//
+// Returns:
+//     lat: Geodetic latitude [rad]
+//     lon: Longitude [rad], 0 on the polar axis
+//     height: Height above the ellipsoid [m]
+void geomag_itrf_to_geodetic(const real (*pos_itrf)[3], real *lat, real *lon, real *height);
+
+// Returns the local north, east, down unit vectors at a geodetic position.
+//
+// Args:
+//     lat: Geodetic latitude [rad]
+//     lon: Longitude [rad]
+//
+// Returns:
+//     ned: Rows are the north, east and down unit vectors in ITRF frame
+void geomag_ned_frame(real lat, real lon, real (*ned)[3]);
+
+// Returns magnetic field vector in the local NED frame at a geodetic position.
+//
+// Equivalent to converting with `geomag_geodetic_to_itrf`, evaluating and
+// rotating into `geomag_ned_frame`, but the conversion and rotation share
+// one set of sines and cosines.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     lla: WGS 84 geodetic latitude [rad], longitude [rad] and height [m]
+//
+// Returns:
+//     mag_ned: Magnetic field vector in north, east, down components [T]
+void geomag_eval_geodetic(const struct geomag_model *model, real dyear, const real (*lla)[3], real (*mag_ned)[3]);
+
+// Returns magnetic field vectors in the local NED frame for a batch of
+// geodetic positions.
+//
+// Samples are split across threads when compiled with OpenMP.
+//
+// Args:
+//     model: Magnetic field model
+//     count: Number of positions
+//     dyear: Decimal year of each position
+//     lla: WGS 84 geodetic latitude [rad], longitude [rad] and height [m] of
+//         each position
+//
+// Returns:
+//     mag_ned: Magnetic field vectors in north, east, down components [T]
+void geomag_geodetic_batch(
+    const struct geomag_model *model, size_t count, const real *dyear, const real (*lla)[3],
+    real (*mag_ned)[3]
+);
+
+// Computes magnetic elements from NED field vectors.
+//
+// The loop is branch free so that it vectorizes.
+//
+// Args:
+//     count: Number of positions
+//     lla: WGS 84 geodetic latitude [rad], longitude [rad] and height [m] of
+//         each position
+//     mag_ned: Magnetic field vectors in north, east, down components [T]
+//
+// Returns:
+//     elements: Magnetic elements at each position
+void geomag_elements(
+    size_t count, const real (*lla)[3], const real (*mag_ned)[3], struct geomag_elements *elements
+);
+
+// Returns magnetic elements for a batch of geodetic positions.
+//
+// Evaluates `geomag_geodetic_batch` and `geomag_elements` a block of
+// positions at a time, so the field vectors never leave the cache. Blocks
+// are split across threads when compiled with OpenMP.
+//
+// Args:
+//     model: Magnetic field model
+//     count: Number of positions
+//     dyear: Decimal year of each position
+//     lla: WGS 84 geodetic latitude [rad], longitude [rad] and height [m] of
+//         each position
+//
+// Returns:
+//     elements: Magnetic elements at each position
+void geomag_elements_batch(
+    const struct geomag_model *model, size_t count, const real *dyear, const real (*lla)[3],
+    struct geomag_elements *elements
+);
+
+// Returns magnetic field vectors along a row of a geodetic grid.
+//
+// Every point of the row has the same latitude and height, so they differ
+// only by a rotation about the polar axis. The spherical harmonic basis is
+// computed once at longitude 0 and contracted with the coefficients into a
+// Fourier series in longitude, after which each point costs O(WMM_NMAX)
+// rather than O(WMM_NMAX^2).
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     lat: WGS 84 geodetic latitude of the row [rad]
+//     height: Height of the row above the ellipsoid [m]
+//     num_lons: Number of points in the row
+//     lons: Longitude of each point [rad]
+//
+// Returns:
+//     mag_itrf: Magnetic field vectors in ITRF frame [T]
+void geomag_grid_row(
+    const struct geomag_model *model, real dyear, real lat, real height, size_t num_lons, const real *lons,
+    real (*mag_itrf)[3]
+);
+
+// Returns magnetic field vectors on a geodetic grid.
+//
+// Evaluates `geomag_grid_row` for every height and latitude, split across
+// threads when compiled with OpenMP. Output is ordered by height, then
+// latitude, then longitude, with longitude varying fastest.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     num_heights: Number of heights
+//     heights: Heights above the WGS 84 ellipsoid [m]
+//     num_lats: Number of latitudes
+//     lats: WGS 84 geodetic latitudes [rad]
+//     num_lons: Number of longitudes
+//     lons: Longitudes [rad]
+//
+// Returns:
+//     mag_itrf: `num_heights * num_lats * num_lons` magnetic field vectors in
+//         ITRF frame [T]
+void geomag_grid(
+    const struct geomag_model *model, real dyear, size_t num_heights, const real *heights, size_t num_lats,
+    const real *lats, size_t num_lons, const real *lons, real (*mag_itrf)[3]
+);
+
 #endif // GEOMAG_H
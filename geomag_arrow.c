@@ -0,0 +1,274 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_arrow.h"
+#include "stdlib.h"
+#include "string.h"
+
+// Input columns, the last one optional
+enum { COL_X, COL_Y, COL_Z, COL_DYEAR, NUM_COLS };
+static const char *const INPUT_NAMES[NUM_COLS] = {"x", "y", "z", "dyear"};
+static const char *const OUTPUT_NAMES[3] = {"bx", "by", "bz"};
+
+// A float64 input column, already offset to the parent's first row
+struct column {
+    const double *values;
+    const uint8_t *validity;
+    int64_t offset;
+};
+
+// What an output column owns, so it outlives the parent once moved out
+struct child_data {
+    const void *buffers[2];
+    double *values;
+};
+
+// What the output array owns besides its children
+struct array_data {
+    struct ArrowArray children[3];
+    struct ArrowArray *child_ptrs[3];
+    const void *buffers[1];
+    uint8_t *validity;
+};
+
+struct schema_data {
+    struct ArrowSchema children[3];
+    struct ArrowSchema *child_ptrs[3];
+};
+
+static int is_valid(const uint8_t *validity, const int64_t i) {
+    return validity == NULL || (validity[i >> 3] >> (i & 7)) & 1;
+}
+
+// Whether a row and all the values it uses are non-null
+static int row_valid(
+    const struct column cols[NUM_COLS], const uint8_t *parent_validity, const int64_t parent_offset,
+    const int64_t i
+) {
+    int valid = is_valid(parent_validity, parent_offset + i);
+    for (int c = 0; c < NUM_COLS; ++c) {
+        valid = valid && (cols[c].values == NULL || is_valid(cols[c].validity, cols[c].offset + i));
+    }
+    return valid;
+}
+
+static real column_value(const struct column *col, const int64_t i) {
+    return col->values[col->offset + i];
+}
+
+static void release_child_array(struct ArrowArray *array) {
+    struct child_data *data = array->private_data;
+    free(data->values);
+    free(data);
+    array->release = NULL;
+}
+
+static void release_array(struct ArrowArray *array) {
+    struct array_data *data = array->private_data;
+    for (int i = 0; i < 3; ++i) {
+        // Children moved out were marked released by the consumer, and free
+        // themselves
+        if (data->children[i].release != NULL) {
+            data->children[i].release(&data->children[i]);
+        }
+    }
+    free(data->validity);
+    free(data);
+    array->release = NULL;
+}
+
+static void release_child_schema(struct ArrowSchema *schema) {
+    schema->release = NULL;
+}
+
+static void release_schema(struct ArrowSchema *schema) {
+    struct schema_data *data = schema->private_data;
+    for (int i = 0; i < 3; ++i) {
+        if (data->children[i].release != NULL) {
+            data->children[i].release(&data->children[i]);
+        }
+    }
+    free(data);
+    schema->release = NULL;
+}
+
+// Finds the input columns, returns -1 if a required one is missing or not float64
+static int find_columns(
+    const struct ArrowSchema *schema, const struct ArrowArray *array, struct column cols[NUM_COLS]
+) {
+    if (strcmp(schema->format, "+s") != 0 || schema->n_children != array->n_children) {
+        return -1;
+    }
+    for (int c = 0; c < NUM_COLS; ++c) {
+        cols[c].values = NULL;
+    }
+    for (int64_t i = 0; i < schema->n_children; ++i) {
+        const struct ArrowSchema *child_schema = schema->children[i];
+        const struct ArrowArray *child = array->children[i];
+        for (int c = 0; c < NUM_COLS; ++c) {
+            if (child_schema->name == NULL || strcmp(child_schema->name, INPUT_NAMES[c]) != 0) {
+                continue;
+            }
+            if (strcmp(child_schema->format, "g") != 0 || child->n_buffers != 2) {
+                return -1;
+            }
+            // A struct's offset applies on top of its children's
+            cols[c].offset = child->offset + array->offset;
+            cols[c].validity = (child->null_count != 0) ? child->buffers[0] : NULL;
+            cols[c].values = child->buffers[1];
+        }
+    }
+    return (cols[COL_X].values && cols[COL_Y].values && cols[COL_Z].values) ? 0 : -1;
+}
+
+// Sets up an output column of `length` values, returns -1 if out of memory
+static int init_child_array(struct ArrowArray *child, const int64_t length) {
+    struct child_data *data = malloc(sizeof(struct child_data));
+    double *values = malloc((size_t) (length > 0 ? length : 1) * sizeof(double));
+    if (data == NULL || values == NULL) {
+        free(data);
+        free(values);
+        child->release = NULL;
+        return -1;
+    }
+    data->values = values;
+    data->buffers[0] = NULL;
+    data->buffers[1] = values;
+    child->length = length;
+    child->null_count = 0;
+    child->offset = 0;
+    child->n_buffers = 2;
+    child->n_children = 0;
+    child->buffers = data->buffers;
+    child->children = NULL;
+    child->dictionary = NULL;
+    child->release = release_child_array;
+    child->private_data = data;
+    return 0;
+}
+
+static void init_child_schema(struct ArrowSchema *child, const char *name) {
+    child->format = "g";
+    child->name = name;
+    child->metadata = NULL;
+    child->flags = 0;
+    child->n_children = 0;
+    child->children = NULL;
+    child->dictionary = NULL;
+    child->release = release_child_schema;
+    child->private_data = NULL;
+}
+
+int geomag_arrow_eval(
+    const struct geomag_model *model, const struct ArrowSchema *schema, const struct ArrowArray *array,
+    const real dyear, struct ArrowSchema *out_schema, struct ArrowArray *out_array
+) {
+    struct column cols[NUM_COLS];
+    if (sizeof(real) != sizeof(double) || find_columns(schema, array, cols) != 0) {
+        return -1;
+    }
+    const int64_t length = array->length;
+    const uint8_t *parent_validity = (array->null_count != 0) ? array->buffers[0] : NULL;
+
+    struct array_data *data = malloc(sizeof(struct array_data));
+    struct schema_data *schema_data = malloc(sizeof(struct schema_data));
+    uint8_t *validity = calloc((size_t) (length + 7) / 8 + 1, 1);
+    int failed = (data == NULL || schema_data == NULL || validity == NULL);
+    for (int c = 0; c < 3; ++c) {
+        if (data != NULL) {
+            failed |= init_child_array(&data->children[c], length) != 0;
+        }
+    }
+    if (failed) {
+        for (int c = 0; c < 3 && data != NULL; ++c) {
+            if (data->children[c].release != NULL) {
+                data->children[c].release(&data->children[c]);
+            }
+        }
+        free(data);
+        free(schema_data);
+        free(validity);
+        return -1;
+    }
+    double *values[3];
+    for (int c = 0; c < 3; ++c) {
+        values[c] = ((struct child_data *) data->children[c].private_data)->values;
+    }
+
+    int64_t null_count = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:null_count)
+#endif
+    for (int64_t i = 0; i < length; ++i) {
+        real mag[3] = {0, 0, 0};
+        if (row_valid(cols, parent_validity, array->offset, i)) {
+            const real pos[3] = {
+                column_value(&cols[COL_X], i), column_value(&cols[COL_Y], i), column_value(&cols[COL_Z], i)
+            };
+            const real row_dyear = cols[COL_DYEAR].values ? column_value(&cols[COL_DYEAR], i) : dyear;
+            geomag_eval(model, row_dyear, &pos, &mag);
+        } else {
+            ++null_count;
+        }
+        for (int c = 0; c < 3; ++c) {
+            values[c][i] = mag[c];
+        }
+    }
+    // Bytes are shared between rows, so set validity bits after the loop
+    for (int64_t i = 0; i < length; ++i) {
+        validity[i >> 3] |= (uint8_t) (row_valid(cols, parent_validity, array->offset, i) << (i & 7));
+    }
+
+    data->validity = validity;
+    data->buffers[0] = (null_count != 0) ? validity : NULL;
+    for (int c = 0; c < 3; ++c) {
+        data->child_ptrs[c] = &data->children[c];
+    }
+    out_array->length = length;
+    out_array->null_count = null_count;
+    out_array->offset = 0;
+    out_array->n_buffers = 1;
+    out_array->n_children = 3;
+    out_array->buffers = data->buffers;
+    out_array->children = data->child_ptrs;
+    out_array->dictionary = NULL;
+    out_array->release = release_array;
+    out_array->private_data = data;
+
+    for (int c = 0; c < 3; ++c) {
+        init_child_schema(&schema_data->children[c], OUTPUT_NAMES[c]);
+        schema_data->child_ptrs[c] = &schema_data->children[c];
+    }
+    out_schema->format = "+s";
+    out_schema->name = NULL;
+    out_schema->metadata = NULL;
+    out_schema->flags = (null_count != 0) ? ARROW_FLAG_NULLABLE : 0;
+    out_schema->n_children = 3;
+    out_schema->children = schema_data->child_ptrs;
+    out_schema->dictionary = NULL;
+    out_schema->release = release_schema;
+    out_schema->private_data = schema_data;
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_ARROW_H
+#define GEOMAG_ARROW_H
+
+#include <stdint.h>
+
+#include "geomag.h"
+
+// Apache Arrow C Data Interface, as published in the Arrow specification.
+// Guarded so it can coexist with the same definitions from other headers.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    // Array type description
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema *);
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray *);
+    // Opaque producer-specific data
+    void *private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+// Evaluates a columnar batch of positions held in an Arrow struct array.
+//
+// The input is a struct array with float64 children named `x`, `y` and `z`
+// holding ECEF positions in ITRF frame [m], and optionally `dyear` holding
+// decimal years. Other children are ignored. Input buffers are read in
+// place, honouring offsets and validity bitmaps, and are not released.
+//
+// The output is a new struct array with float64 children `bx`, `by` and
+// `bz` holding the field in ITRF frame [T]. A row is null where the input
+// row or any of its used values is null. The caller owns the output and
+// must call its release callbacks.
+//
+// Requires `real` to be double.
+//
+// Args:
+//     model: Magnetic field model
+//     schema: Schema of the input struct array
+//     array: Input struct array
+//     dyear: Decimal year for every row when there is no `dyear` column
+//
+// Returns:
+//     out_schema: Schema of the output struct array
+//     out_array: Output struct array
+//     0 on success, -1 if the input does not match or allocation fails, in
+//     which case nothing is allocated
+int geomag_arrow_eval(
+    const struct geomag_model *model, const struct ArrowSchema *schema, const struct ArrowArray *array,
+    real dyear, struct ArrowSchema *out_schema, struct ArrowArray *out_array
+);
+
+#endif // GEOMAG_ARROW_H
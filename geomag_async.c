@@ -0,0 +1,203 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_async.h"
+#include "stdatomic.h"
+#include "stdlib.h"
+#include "string.h"
+
+// The idle worker yields, where C11 threads exist
+#ifndef __STDC_NO_THREADS__
+#include "threads.h"
+#define WAIT() thrd_yield()
+#else
+#define WAIT() ((void) 0)
+#endif
+
+// Size of a cache line, to keep the cursors apart [bytes]
+#define LINE_SIZE 64
+
+struct async_slot {
+    real dyear;
+    real pos[3];
+    real mag[3];
+    real posted_at;
+};
+
+struct geomag_async {
+    const struct geomag_model *model;
+    struct async_slot *slots;
+    size_t mask;
+    atomic_bool stop;
+    // Positions posted, written by the control thread
+    _Alignas(LINE_SIZE) atomic_size_t posted;
+    // Positions evaluated, written by the worker
+    _Alignas(LINE_SIZE) atomic_size_t completed;
+    // Results collected, and statistics, only touched by the control thread
+    _Alignas(LINE_SIZE) size_t collected;
+    struct geomag_async_stats stats;
+};
+
+struct geomag_async *geomag_async_new(const struct geomag_model *model, const size_t capacity) {
+    if (capacity == 0 || capacity > SIZE_MAX / 2 / sizeof(struct async_slot)) {
+        return NULL;
+    }
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    struct geomag_async *queue = aligned_alloc(LINE_SIZE, sizeof(struct geomag_async));
+    struct async_slot *slots = malloc(size * sizeof(struct async_slot));
+    if (queue == NULL || slots == NULL) {
+        free(queue);
+        free(slots);
+        return NULL;
+    }
+    queue->model = model;
+    queue->slots = slots;
+    queue->mask = size - 1;
+    atomic_init(&queue->stop, 0);
+    atomic_init(&queue->posted, 0);
+    atomic_init(&queue->completed, 0);
+    queue->collected = 0;
+    memset(&queue->stats, 0, sizeof(queue->stats));
+    return queue;
+}
+
+void geomag_async_free(struct geomag_async *queue) {
+    if (queue != NULL) {
+        free(queue->slots);
+        free(queue);
+    }
+}
+
+int geomag_async_post(struct geomag_async *queue, const real now, const real dyear, const real (*pos_itrf)[3]) {
+    const size_t posted = atomic_load_explicit(&queue->posted, memory_order_relaxed);
+    // Slots are reused only once collected, so results are never overwritten
+    if (posted - queue->collected > queue->mask) {
+        ++queue->stats.overflows;
+        return -1;
+    }
+    struct async_slot *slot = &queue->slots[posted & queue->mask];
+    slot->dyear = dyear;
+    slot->pos[0] = (*pos_itrf)[0];
+    slot->pos[1] = (*pos_itrf)[1];
+    slot->pos[2] = (*pos_itrf)[2];
+    slot->posted_at = now;
+    atomic_store_explicit(&queue->posted, posted + 1, memory_order_release);
+    ++queue->stats.posted;
+    return 0;
+}
+
+// Takes the result at `index` and records its latency
+static void collect(
+    struct geomag_async *queue, const size_t index, const real now, struct geomag_async_result *result
+) {
+    const struct async_slot *slot = &queue->slots[index & queue->mask];
+    result->dyear = slot->dyear;
+    for (int k = 0; k < 3; ++k) {
+        result->pos_itrf[k] = slot->pos[k];
+        result->mag_itrf[k] = slot->mag[k];
+    }
+    const real latency = now - slot->posted_at;
+    result->latency = latency;
+
+    struct geomag_async_stats *stats = &queue->stats;
+    stats->latency_min = (stats->collected == 0 || latency < stats->latency_min) ? latency : stats->latency_min;
+    stats->latency_max = (stats->collected == 0 || latency > stats->latency_max) ? latency : stats->latency_max;
+    stats->latency_sum += latency;
+    ++stats->collected;
+    int bucket = 0;
+    for (real edge = (real) 1e-6; bucket < GEOMAG_ASYNC_BUCKETS - 1 && latency >= edge; edge *= 2) {
+        ++bucket;
+    }
+    ++stats->histogram[bucket];
+}
+
+int geomag_async_poll(struct geomag_async *queue, const real now, struct geomag_async_result *result) {
+    const size_t completed = atomic_load_explicit(&queue->completed, memory_order_acquire);
+    if (queue->collected == completed) {
+        return 0;
+    }
+    collect(queue, queue->collected, now, result);
+    ++queue->collected;
+    return 1;
+}
+
+int geomag_async_latest(struct geomag_async *queue, const real now, struct geomag_async_result *result) {
+    const size_t completed = atomic_load_explicit(&queue->completed, memory_order_acquire);
+    if (queue->collected == completed) {
+        return 0;
+    }
+    queue->stats.skipped += completed - queue->collected - 1;
+    collect(queue, completed - 1, now, result);
+    queue->collected = completed;
+    return 1;
+}
+
+void geomag_async_get_stats(const struct geomag_async *queue, struct geomag_async_stats *stats) {
+    *stats = queue->stats;
+}
+
+real geomag_async_percentile(const struct geomag_async_stats *stats, const real q) {
+    if (stats->collected == 0) {
+        return 0;
+    }
+    // Rank of the quantile among the collected latencies, from 1
+    const real rank = q * (real) (stats->collected - 1) + 1;
+    uint64_t seen = 0;
+    real edge = (real) 1e-6;
+    for (int bucket = 0; bucket < GEOMAG_ASYNC_BUCKETS - 1; ++bucket, edge *= 2) {
+        seen += stats->histogram[bucket];
+        if ((real) seen >= rank) {
+            return (edge < stats->latency_max) ? edge : stats->latency_max;
+        }
+    }
+    return stats->latency_max;
+}
+
+size_t geomag_async_work(struct geomag_async *queue) {
+    const size_t posted = atomic_load_explicit(&queue->posted, memory_order_acquire);
+    const size_t start = atomic_load_explicit(&queue->completed, memory_order_relaxed);
+    for (size_t i = start; i != posted; ++i) {
+        struct async_slot *slot = &queue->slots[i & queue->mask];
+        geomag_eval(queue->model, slot->dyear, (const real (*)[3]) &slot->pos, &slot->mag);
+        // Published one by one, so the control thread sees each as it is done
+        atomic_store_explicit(&queue->completed, i + 1, memory_order_release);
+    }
+    return posted - start;
+}
+
+void geomag_async_run(struct geomag_async *queue) {
+    while (!atomic_load_explicit(&queue->stop, memory_order_relaxed)) {
+        if (geomag_async_work(queue) == 0) {
+            WAIT();
+        }
+    }
+}
+
+void geomag_async_stop(struct geomag_async *queue) {
+    atomic_store_explicit(&queue->stop, 1, memory_order_relaxed);
+}
@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_ASYNC_H
+#define GEOMAG_ASYNC_H
+
+#include <stdint.h>
+
+#include "geomag.h"
+
+// Buckets of the latency histogram, the first under 1 us, then one per
+// doubling, the last also holding anything longer
+#define GEOMAG_ASYNC_BUCKETS 32
+
+// Queue offloading field evaluations from a real-time thread.
+//
+// A single control thread posts positions and collects finished fields,
+// and a single worker thread evaluates them, exchanging them through a ring
+// without locks, so neither ever blocks the control thread. Each cursor of
+// the ring is written by one side only and read by the other with
+// acquire/release ordering, built on C11 atomics, so this file is compiled
+// with -std=c11 while its header stays usable from C99 and C++.
+//
+// When the ring is full, because the worker is behind or results are not
+// collected, a post is rejected and counted as an overflow. Nothing in
+// flight is overwritten, and the control thread keeps its last result until
+// the worker catches up.
+struct geomag_async;
+
+// A finished evaluation
+struct geomag_async_result {
+    // Decimal year and ECEF position in ITRF frame [m], as posted
+    real dyear;
+    real pos_itrf[3];
+    // Magnetic field vector in ITRF frame [T]
+    real mag_itrf[3];
+    // Time from posting to collecting [s]
+    real latency;
+};
+
+// Counters and latency statistics, kept by the control thread
+struct geomag_async_stats {
+    uint64_t posted;
+    // Posts rejected on a full ring
+    uint64_t overflows;
+    uint64_t collected;
+    // Results skipped for newer ones by `geomag_async_latest`
+    uint64_t skipped;
+    // Over collected results [s]
+    real latency_min, latency_max, latency_sum;
+    uint64_t histogram[GEOMAG_ASYNC_BUCKETS];
+};
+
+// Creates a queue.
+//
+// Args:
+//     model: Magnetic field model, which must outlive the queue
+//     capacity: Evaluations in flight, rounded up to a power of two
+//
+// Returns:
+//     New queue, or NULL if out of memory or `capacity` is 0
+struct geomag_async *geomag_async_new(const struct geomag_model *model, size_t capacity);
+
+// Frees a queue whose worker has returned.
+void geomag_async_free(struct geomag_async *queue);
+
+// Posts a position for evaluation, from the control thread. Never blocks.
+//
+// Args:
+//     queue: Queue
+//     now: Current time on any monotonic clock [s]
+//     dyear: Decimal year
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//
+// Returns:
+//     0 if posted, -1 if the ring is full
+int geomag_async_post(struct geomag_async *queue, real now, real dyear, const real (*pos_itrf)[3]);
+
+// Collects the oldest finished result, from the control thread. Never
+// blocks.
+//
+// Args:
+//     queue: Queue
+//     now: Current time on the clock passed to `geomag_async_post` [s]
+//
+// Returns:
+//     result: Oldest result not yet collected
+//     1 if a result was collected, 0 if none is finished
+int geomag_async_poll(struct geomag_async *queue, real now, struct geomag_async_result *result);
+
+// Collects the newest finished result, skipping older ones, from the
+// control thread. Never blocks.
+//
+// Args:
+//     queue: Queue
+//     now: Current time on the clock passed to `geomag_async_post` [s]
+//
+// Returns:
+//     result: Newest finished result
+//     1 if a result was collected, 0 if none is finished
+int geomag_async_latest(struct geomag_async *queue, real now, struct geomag_async_result *result);
+
+// Returns the statistics so far, from the control thread.
+void geomag_async_get_stats(const struct geomag_async *queue, struct geomag_async_stats *stats);
+
+// Returns an upper bound on a latency quantile from the histogram.
+//
+// Args:
+//     stats: Statistics from `geomag_async_get_stats`
+//     q: Quantile in [0, 1], such as 0.99
+//
+// Returns:
+//     Upper edge of the histogram bucket holding the quantile, at most the
+//     largest latency [s], 0 if nothing was collected
+real geomag_async_percentile(const struct geomag_async_stats *stats, real q);
+
+// Evaluates every posted position, from the worker thread.
+//
+// For callers running the worker from their own loop.
+//
+// Returns:
+//     Number of positions evaluated
+size_t geomag_async_work(struct geomag_async *queue);
+
+// Runs the worker until `geomag_async_stop`.
+//
+// Polls for posts, yielding where C11 threads are available, so it is
+// meant for a thread of its own, which the caller may pin to a core.
+void geomag_async_run(struct geomag_async *queue);
+
+// Asks `geomag_async_run` to return, from any thread.
+void geomag_async_stop(struct geomag_async *queue);
+
+#endif // GEOMAG_ASYNC_H
@@ -0,0 +1,231 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_cheb.h"
+#include "math.h"
+#include "string.h"
+
+static const real PI = 3.14159265358979323846;
+
+// Identifies the file format, with its version in the last byte
+static const char CHEB_MAGIC[8] = {'G', 'M', 'C', 'H', 'E', 'B', '\0', '\1'};
+
+// Points the fit error is checked at, per node
+#define CHECKS_PER_NODE 4
+
+void geomag_cheb_init(struct geomag_cheb *cheb, struct geomag_cheb_segment *segments, const size_t capacity) {
+    cheb->degree = 0;
+    cheb->count = 0;
+    cheb->capacity = capacity;
+    cheb->segments = segments;
+}
+
+// Evaluates a Chebyshev series at x in [-1, 1] by Clenshaw's recurrence
+static real clenshaw(const real *coeffs, const int degree, const real x) {
+    real b1 = 0, b2 = 0;
+    for (int k = degree; k >= 1; --k) {
+        const real b0 = 2 * x * b1 - b2 + coeffs[k];
+        b2 = b1;
+        b1 = b0;
+    }
+    return x * b1 - b2 + coeffs[0];
+}
+
+static void segment_eval(
+    const struct geomag_cheb_segment *segment, const int degree, const real t, real (*mag_itrf)[3]
+) {
+    const real half_span = REAL_HALF * (segment->t_end - segment->t_begin);
+    const real x = (t - segment->t_begin) / half_span - 1;
+    for (int i = 0; i < 3; ++i) {
+        (*mag_itrf)[i] = clenshaw(segment->coeffs[i], degree, x);
+    }
+}
+
+static void field_at(
+    const struct geomag_model *model, const geomag_ephemeris ephem, void *ctx, const real t, real (*mag_itrf)[3]
+) {
+    real dyear;
+    real pos_itrf[3];
+    ephem(ctx, t, &dyear, &pos_itrf);
+    geomag_eval(model, dyear, (const real (*)[3]) &pos_itrf, mag_itrf);
+}
+
+// Fits one segment by interpolating at Chebyshev nodes, returns the largest
+// error over CHECKS_PER_NODE points per node, spaced evenly in angle
+// between the segment ends
+static real fit_segment(
+    struct geomag_cheb_segment *segment, const int degree, const struct geomag_model *model,
+    const geomag_ephemeris ephem, void *ctx
+) {
+    const int num_nodes = degree + 1;
+    const real mid = REAL_HALF * (segment->t_begin + segment->t_end);
+    const real half_span = REAL_HALF * (segment->t_end - segment->t_begin);
+    real values[GEOMAG_CHEB_MAX_DEGREE + 1][3];
+
+    for (int j = 0; j < num_nodes; ++j) {
+        const real x = REAL_COS(PI * (j + REAL_HALF) / num_nodes);
+        field_at(model, ephem, ctx, mid + half_span * x, &values[j]);
+    }
+    // Discrete cosine transform of the node values
+    for (int k = 0; k < num_nodes; ++k) {
+        real sums[3] = {0, 0, 0};
+        for (int j = 0; j < num_nodes; ++j) {
+            const real weight = REAL_COS(PI * k * (j + REAL_HALF) / num_nodes);
+            for (int i = 0; i < 3; ++i) {
+                sums[i] += weight * values[j][i];
+            }
+        }
+        for (int i = 0; i < 3; ++i) {
+            segment->coeffs[i][k] = sums[i] * ((k == 0) ? 1 : 2) / num_nodes;
+        }
+    }
+
+    // Interpolation error peaks between nodes and is largest towards the
+    // ends, so check both ends and several points between each pair of nodes
+    const int num_checks = CHECKS_PER_NODE * num_nodes;
+    real max_err = 0;
+    for (int j = 0; j <= num_checks; ++j) {
+        const real x = REAL_COS(PI * j / num_checks);
+        const real t = mid + half_span * x;
+        real exact[3], approx[3];
+        field_at(model, ephem, ctx, t, &exact);
+        segment_eval(segment, degree, t, &approx);
+        for (int i = 0; i < 3; ++i) {
+            const real err = REAL_FABS(exact[i] - approx[i]);
+            max_err = (err > max_err) ? err : max_err;
+        }
+    }
+    return max_err;
+}
+
+int geomag_cheb_fit(
+    struct geomag_cheb *cheb, const struct geomag_model *model, const geomag_ephemeris ephem, void *ctx,
+    const real t_begin, const real t_end, const int degree, const real max_segment, const real tol
+) {
+    if (degree < 1 || degree > GEOMAG_CHEB_MAX_DEGREE || !(t_end > t_begin) || !(max_segment > 0)) {
+        return -1;
+    }
+    // Give up on segments this small relative to the span
+    const real min_segment = (t_end - t_begin) * 1e-9;
+    cheb->degree = degree;
+    cheb->count = 0;
+
+    real t = t_begin;
+    real length = max_segment;
+    while (t < t_end) {
+        if (cheb->count == cheb->capacity) {
+            return -1;
+        }
+        struct geomag_cheb_segment *segment = &cheb->segments[cheb->count];
+        const int last = (t + length >= t_end);
+        segment->t_begin = t;
+        segment->t_end = last ? t_end : t + length;
+        if (fit_segment(segment, degree, model, ephem, ctx) > tol) {
+            length = REAL_HALF * (segment->t_end - segment->t_begin);
+            if (length < min_segment) {
+                return -1;
+            }
+            continue;
+        }
+        ++cheb->count;
+        if (last) {
+            break;
+        }
+        t = segment->t_end;
+        length = (2 * length < max_segment) ? 2 * length : max_segment;
+    }
+    return 0;
+}
+
+void geomag_cheb_eval(const struct geomag_cheb *cheb, const real t, real (*mag_itrf)[3]) {
+    // Binary search for the last segment starting at or before t
+    size_t lo = 0, hi = cheb->count;
+    while (hi - lo > 1) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (cheb->segments[mid].t_begin <= t) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    segment_eval(&cheb->segments[lo], cheb->degree, t, mag_itrf);
+}
+
+int geomag_cheb_write(const struct geomag_cheb *cheb, FILE *file) {
+    const double header[2] = {(double) cheb->degree, (double) cheb->count};
+    if (fwrite(CHEB_MAGIC, sizeof(CHEB_MAGIC), 1, file) != 1 || fwrite(header, sizeof(header), 1, file) != 1) {
+        return -1;
+    }
+    for (size_t s = 0; s < cheb->count; ++s) {
+        const struct geomag_cheb_segment *segment = &cheb->segments[s];
+        double values[2 + 3 * (GEOMAG_CHEB_MAX_DEGREE + 1)];
+        size_t len = 0;
+        values[len++] = (double) segment->t_begin;
+        values[len++] = (double) segment->t_end;
+        for (int i = 0; i < 3; ++i) {
+            for (int k = 0; k <= cheb->degree; ++k) {
+                values[len++] = (double) segment->coeffs[i][k];
+            }
+        }
+        if (fwrite(values, sizeof(double), len, file) != len) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int geomag_cheb_read(struct geomag_cheb *cheb, FILE *file) {
+    char magic[sizeof(CHEB_MAGIC)];
+    double header[2];
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, CHEB_MAGIC, sizeof(magic)) != 0) {
+        return -1;
+    }
+    if (fread(header, sizeof(header), 1, file) != 1) {
+        return -1;
+    }
+    const int degree = (int) header[0];
+    if (degree < 1 || degree > GEOMAG_CHEB_MAX_DEGREE || !(header[1] >= 0) || header[1] > (double) cheb->capacity) {
+        return -1;
+    }
+    const size_t count = (size_t) header[1];
+    for (size_t s = 0; s < count; ++s) {
+        struct geomag_cheb_segment *segment = &cheb->segments[s];
+        double values[2 + 3 * (GEOMAG_CHEB_MAX_DEGREE + 1)];
+        const size_t len = 2 + 3 * (size_t) (degree + 1);
+        if (fread(values, sizeof(double), len, file) != len) {
+            return -1;
+        }
+        segment->t_begin = (real) values[0];
+        segment->t_end = (real) values[1];
+        for (int i = 0; i < 3; ++i) {
+            for (int k = 0; k <= degree; ++k) {
+                segment->coeffs[i][k] = (real) values[2 + i * (degree + 1) + k];
+            }
+        }
+    }
+    cheb->degree = degree;
+    cheb->count = count;
+    return 0;
+}
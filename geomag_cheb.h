@@ -0,0 +1,134 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_CHEB_H
+#define GEOMAG_CHEB_H
+
+#include "geomag.h"
+#include <stdio.h>
+
+// Maximum Chebyshev degree of a segment
+#define GEOMAG_CHEB_MAX_DEGREE 24
+
+// Chebyshev expansion of the field over one time segment
+struct geomag_cheb_segment {
+    real t_begin, t_end;
+    // Coefficients of each ITRF component [T]
+    real coeffs[3][GEOMAG_CHEB_MAX_DEGREE + 1];
+};
+
+// Piecewise Chebyshev fit of the field along an ephemeris.
+//
+// Segments are stored in caller provided memory, in increasing time.
+struct geomag_cheb {
+    int degree;
+    size_t count;
+    size_t capacity;
+    struct geomag_cheb_segment *segments;
+};
+
+// Ephemeris to fit along.
+//
+// Args:
+//     ctx: Caller context
+//     t: Time, in any unit as long as it's consistent
+//
+// Returns:
+//     dyear: Decimal year at `t`
+//     pos_itrf: ECEF position vector in ITRF frame at `t` [m]
+typedef void (*geomag_ephemeris)(void *ctx, real t, real *dyear, real (*pos_itrf)[3]);
+
+// Initializes an empty fit over caller provided segment storage.
+//
+// Args:
+//     segments: Storage for up to `capacity` segments
+//     capacity: Number of segments in `segments`
+//
+// Returns:
+//     cheb: Empty fit
+void geomag_cheb_init(struct geomag_cheb *cheb, struct geomag_cheb_segment *segments, size_t capacity);
+
+// Fits piecewise Chebyshev polynomials to the field along an ephemeris.
+//
+// Segment lengths adapt, halving until the fit is within `tol` of the field,
+// and growing back up to `max_segment` after each accepted segment. The
+// error is sampled at both segment ends and four points per fit node, which
+// for a smooth field bounds it closely but is not a strict guarantee.
+//
+// Args:
+//     cheb: Fit, from `geomag_cheb_init`
+//     model: Magnetic field model
+//     ephem: Ephemeris
+//     ctx: Context passed to `ephem`
+//     t_begin, t_end: Time span to fit
+//     degree: Chebyshev degree, up to `GEOMAG_CHEB_MAX_DEGREE`
+//     max_segment: Longest segment to use
+//     tol: Tolerance on each field component [T]
+//
+// Returns:
+//     cheb: Fit covering `t_begin` to `t_end`
+//     0 on success, -1 if `cheb` ran out of segments or `tol` can't be met
+int geomag_cheb_fit(
+    struct geomag_cheb *cheb, const struct geomag_model *model, geomag_ephemeris ephem, void *ctx,
+    real t_begin, real t_end, int degree, real max_segment, real tol
+);
+
+// Returns magnetic field vector in ITRF from a fit.
+//
+// Times outside the fit are extrapolated from the first or last segment.
+//
+// Args:
+//     cheb: Fit with at least one segment
+//     t: Time
+//
+// Returns:
+//     mag_itrf: Magnetic field vector in ITRF frame [T]
+void geomag_cheb_eval(const struct geomag_cheb *cheb, real t, real (*mag_itrf)[3]);
+
+// Writes a fit to a binary file.
+//
+// The file is a header followed by each segment's times and `degree + 1`
+// coefficients per component, all as native byte order doubles.
+//
+// Args:
+//     cheb: Fit
+//     file: File opened for binary writing
+//
+// Returns:
+//     0 on success, -1 on a write error
+int geomag_cheb_write(const struct geomag_cheb *cheb, FILE *file);
+
+// Reads a fit written by `geomag_cheb_write`.
+//
+// Args:
+//     cheb: Fit, from `geomag_cheb_init`
+//     file: File opened for binary reading
+//
+// Returns:
+//     cheb: Fit read from `file`
+//     0 on success, -1 if the file is malformed or too big for `cheb`
+int geomag_cheb_read(struct geomag_cheb *cheb, FILE *file);
+
+#endif // GEOMAG_CHEB_H
@@ -0,0 +1,53 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_cof.h"
+#include "stdlib.h"
+
+int geomag_model_read_cof(FILE *file, struct geomag_model *model) {
+    // Read to the end, growing the buffer, so pipes work too
+    size_t size = 0, capacity = 4096;
+    char *text = malloc(capacity);
+    while (text != NULL) {
+        size += fread(text + size, 1, capacity - 1 - size, file);
+        if (size < capacity - 1) {
+            break;
+        }
+        char *grown = realloc(text, 2 * capacity);
+        if (grown == NULL) {
+            free(text);
+        }
+        text = grown;
+        capacity *= 2;
+    }
+    if (text == NULL || ferror(file)) {
+        free(text);
+        return -1;
+    }
+    text[size] = '\0';
+    const int status = geomag_model_parse_cof(text, model);
+    free(text);
+    return status;
+}
@@ -0,0 +1,152 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_dipole.h"
+#include "math.h"
+
+// Mean radius of ellipsoid, the reference radius of the coefficients
+static const real EARTH_R = 6371200.0;
+
+static const real PI = 3.14159265358979323846;
+
+// Schmidt semi-normalized n <= 2 coefficients [nT]
+struct low_degree {
+    real g10, g11, h11;
+    real g20, g21, h21, g22, h22;
+};
+
+static void low_degree_coeffs(const struct geomag_model *model, const real dyear, struct low_degree *c) {
+    real coeffs[GEOMAG_DESIGN_COLS];
+    geomag_model_coeffs(model, dyear, coeffs, 1);
+    // Indices are m * (2 * WMM_NMAX - m + 1) / 2 + n, and the n = 2 terms
+    // are stored un-normalized by sqrt(2 (n - m)! / (n + m)!)
+    const int i11 = WMM_NMAX + 1, i21 = WMM_NMAX + 2, i22 = 2 * WMM_NMAX + 1;
+    c->g10 = coeffs[2 * 1];
+    c->g11 = coeffs[2 * i11];
+    c->h11 = coeffs[2 * i11 + 1];
+    c->g20 = coeffs[2 * 2];
+    c->g21 = coeffs[2 * i21] * REAL_SQRT(3);
+    c->h21 = coeffs[2 * i21 + 1] * REAL_SQRT(3);
+    c->g22 = coeffs[2 * i22] * REAL_SQRT(12);
+    c->h22 = coeffs[2 * i22 + 1] * REAL_SQRT(12);
+}
+
+static void cross(const real a[3], const real b[3], real out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void normalize(real v[3]) {
+    const real norm = REAL_SQRT(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (int i = 0; i < 3; ++i) {
+        v[i] /= norm;
+    }
+}
+
+void geomag_dipole_init(
+    const struct geomag_model *model, const real dyear, const int eccentric, struct geomag_dipole *dipole
+) {
+    struct low_degree c;
+    low_degree_coeffs(model, dyear, &c);
+    const real b0_sq = c.g10 * c.g10 + c.g11 * c.g11 + c.h11 * c.h11;
+    dipole->dyear = dyear;
+    dipole->b0 = REAL_SQRT(b0_sq) * REAL_NT2T;
+
+    // The dipole moment points south, so the northern pole is opposite
+    real *x = dipole->rot[0], *y = dipole->rot[1], *z = dipole->rot[2];
+    static const real GEO_Y[3] = {0, 1, 0};
+    static const real GEO_Z[3] = {0, 0, 1};
+    z[0] = -c.g11;
+    z[1] = -c.h11;
+    z[2] = -c.g10;
+    normalize(z);
+    cross(GEO_Z, z, y);
+    if (y[0] == 0 && y[1] == 0) {
+        // Axial dipole, keep magnetic longitude geographic
+        y[0] = GEO_Y[0];
+        y[1] = GEO_Y[1];
+        y[2] = GEO_Y[2];
+    }
+    normalize(y);
+    cross(y, z, x);
+
+    dipole->center[0] = dipole->center[1] = dipole->center[2] = 0;
+    if (eccentric) {
+        const real sqrt3 = REAL_SQRT(3);
+        const real l0 = 2 * c.g10 * c.g20 + sqrt3 * (c.g11 * c.g21 + c.h11 * c.h21);
+        const real l1 = -c.g11 * c.g20 + sqrt3 * (c.g10 * c.g21 + c.g11 * c.g22 + c.h11 * c.h22);
+        const real l2 = -c.h11 * c.g20 + sqrt3 * (c.g10 * c.h21 - c.h11 * c.g22 + c.g11 * c.h22);
+        const real e = (l0 * c.g10 + l1 * c.g11 + l2 * c.h11) / (4 * b0_sq);
+        dipole->center[0] = EARTH_R * (l1 - c.g11 * e) / (3 * b0_sq);
+        dipole->center[1] = EARTH_R * (l2 - c.h11 * e) / (3 * b0_sq);
+        dipole->center[2] = EARTH_R * (l0 - c.g10 * e) / (3 * b0_sq);
+    }
+}
+
+void geomag_dipole_coords(
+    const struct geomag_dipole *dipole, const size_t count, const real (*pos_itrf)[3], real (*coords)[3]
+) {
+    // Copied out so the compiler knows they do not alias the output
+    real rot[3][3], center[3];
+    for (int i = 0; i < 3; ++i) {
+        center[i] = dipole->center[i];
+        for (int j = 0; j < 3; ++j) {
+            rot[i][j] = dipole->rot[i][j];
+        }
+    }
+#ifdef _OPENMP
+#pragma omp parallel for simd
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        const real dx = pos_itrf[i][0] - center[0];
+        const real dy = pos_itrf[i][1] - center[1];
+        const real dz = pos_itrf[i][2] - center[2];
+        const real x = rot[0][0] * dx + rot[0][1] * dy + rot[0][2] * dz;
+        const real y = rot[1][0] * dx + rot[1][1] * dy + rot[1][2] * dz;
+        const real z = rot[2][0] * dx + rot[2][1] * dy + rot[2][2] * dz;
+        const real rho = REAL_SQRT(x * x + y * y);
+        coords[i][0] = REAL_ATAN2(z, rho);
+        coords[i][1] = REAL_ATAN2(y, x);
+        coords[i][2] = REAL_SQRT(rho * rho + z * z);
+    }
+}
+
+void geomag_dipole_mlt(
+    const struct geomag_dipole *dipole, const size_t count, const real (*coords)[3], const real (*sun_itrf)[3],
+    real *mlt
+) {
+    const real (*rot)[3] = (const real (*)[3]) dipole->rot;
+#ifdef _OPENMP
+#pragma omp parallel for simd
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        const real *sun = sun_itrf[i];
+        const real x = rot[0][0] * sun[0] + rot[0][1] * sun[1] + rot[0][2] * sun[2];
+        const real y = rot[1][0] * sun[0] + rot[1][1] * sun[1] + rot[1][2] * sun[2];
+        const real hours = 12 + (coords[i][1] - REAL_ATAN2(y, x)) * (12 / PI);
+        mlt[i] = hours - 24 * REAL_FLOOR(hours / 24);
+    }
+}
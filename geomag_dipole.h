@@ -0,0 +1,102 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_DIPOLE_H
+#define GEOMAG_DIPOLE_H
+
+#include "geomag.h"
+
+// Dipole magnetic coordinate frame of a model at an epoch.
+//
+// Building the frame costs a coefficient evaluation, so it is meant to be
+// initialized once per epoch and reused for every batch at that epoch.
+struct geomag_dipole {
+    // Decimal year the frame was built for
+    real dyear;
+    // Rows are the dipole x, y, z axes in ITRF frame. z points to the
+    // northern geomagnetic pole, y is perpendicular to it and the
+    // geographic axis, and x completes the frame towards the
+    // dipole meridian at magnetic longitude 0. An axial dipole keeps the
+    // geographic x and y axes.
+    real rot[3][3];
+    // Dipole centre in ITRF frame, zero unless eccentric [m]
+    real center[3];
+    // Dipole field strength at the equator of the reference sphere [T]
+    real b0;
+};
+
+// Builds the dipole frame of a model at an epoch.
+//
+// The centered dipole axis comes from the n = 1 terms. The eccentric
+// dipole also uses the n = 2 terms to offset the centre, following
+// Fraser-Smith (1987).
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     eccentric: Non-zero for the eccentric dipole, zero for the centered one
+//
+// Returns:
+//     dipole: Dipole frame
+void geomag_dipole_init(
+    const struct geomag_model *model, real dyear, int eccentric, struct geomag_dipole *dipole
+);
+
+// Converts positions to dipole magnetic coordinates.
+//
+// The loop is branch free so that it vectorizes, and is split across
+// threads when compiled with OpenMP.
+//
+// Args:
+//     dipole: Dipole frame
+//     count: Number of positions
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//
+// Returns:
+//     coords: Magnetic latitude [rad], magnetic longitude [rad] and distance
+//         from the dipole centre [m] of each position
+void geomag_dipole_coords(
+    const struct geomag_dipole *dipole, size_t count, const real (*pos_itrf)[3], real (*coords)[3]
+);
+
+// Computes magnetic local time from magnetic longitudes.
+//
+// Magnetic local time is 12 h on the magnetic meridian of the Sun and
+// advances 1 h per 15 degrees of magnetic longitude east of it.
+//
+// Args:
+//     dipole: Dipole frame
+//     count: Number of positions
+//     coords: Magnetic coordinates from `geomag_dipole_coords`
+//     sun_itrf: Direction to the Sun in ITRF frame at each position's time
+//
+// Returns:
+//     mlt: Magnetic local time in [0, 24) [h]
+void geomag_dipole_mlt(
+    const struct geomag_dipole *dipole, size_t count, const real (*coords)[3], const real (*sun_itrf)[3],
+    real *mlt
+);
+
+#endif // GEOMAG_DIPOLE_H
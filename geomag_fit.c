@@ -0,0 +1,186 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_fit.h"
+#include "math.h"
+#include "stdlib.h"
+
+// Coefficient index of (n, m), the layout of `struct geomag_model`
+static int calc_index(const int n, const int m) {
+    return m * (2 * WMM_NMAX - m + 1) / 2 + n;
+}
+
+void geomag_fit_init(struct geomag_fit *fit, const int nmax) {
+    fit->nmax = (nmax < 1) ? 1 : (nmax > WMM_NMAX) ? WMM_NMAX : nmax;
+    fit->num_params = 0;
+    for (int n = 1; n <= fit->nmax; ++n) {
+        for (int m = 0; m <= n; ++m) {
+            const int idx = calc_index(n, m);
+            fit->param_col[fit->num_params++] = 2 * idx;
+            if (m != 0) {
+                // Sine coefficients of order 0 don't exist
+                fit->param_col[fit->num_params++] = 2 * idx + 1;
+            }
+        }
+    }
+    for (int i = 0; i < fit->num_params; ++i) {
+        for (int j = 0; j < fit->num_params; ++j) {
+            fit->normal[i][j] = 0;
+        }
+        fit->rhs[i] = 0;
+    }
+    fit->sum_sq = 0;
+    fit->num_obs = 0;
+}
+
+// Adds the pending block of rows to the normal equations
+static void update_block(struct geomag_fit *fit, const int num_rows) {
+    const int num_params = fit->num_params;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 8)
+#endif
+    for (int i = 0; i < num_params; ++i) {
+        real *normal_row = fit->normal[i];
+        real rhs = 0;
+        for (int r = 0; r < num_rows; ++r) {
+            const real *row = fit->block_rows[r];
+            const real row_i = row[i];
+            for (int j = i; j < num_params; ++j) {
+                normal_row[j] += row_i * row[j];
+            }
+            rhs += row_i * fit->block_res[r];
+        }
+        fit->rhs[i] += rhs;
+    }
+}
+
+void geomag_fit_add(
+    struct geomag_fit *fit, const struct geomag_model *model, const size_t count, const real *dyear,
+    const real (*pos_itrf)[3], const real (*mag_itrf)[3]
+) {
+    real design[3][GEOMAG_DESIGN_COLS];
+    real coeffs[GEOMAG_DESIGN_COLS];
+    int num_rows = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        geomag_design(&pos_itrf[i], design);
+        geomag_model_coeffs(model, dyear[i], coeffs, 1);
+        for (int k = 0; k < 3; ++k) {
+            real predicted = 0;
+            for (int col = 0; col < GEOMAG_DESIGN_COLS; ++col) {
+                predicted += design[k][col] * coeffs[col];
+            }
+            // Work in [nT] so the normal equations are well scaled
+            const real residual = (mag_itrf[i][k] - predicted) / REAL_NT2T;
+            real *row = fit->block_rows[num_rows];
+            for (int p = 0; p < fit->num_params; ++p) {
+                row[p] = design[k][fit->param_col[p]] / REAL_NT2T;
+            }
+            fit->block_res[num_rows] = residual;
+            fit->sum_sq += residual * residual;
+            ++num_rows;
+        }
+        if (num_rows == 3 * GEOMAG_FIT_BLOCK) {
+            update_block(fit, num_rows);
+            num_rows = 0;
+        }
+    }
+    if (num_rows != 0) {
+        update_block(fit, num_rows);
+    }
+    fit->num_obs += count;
+}
+
+void geomag_fit_merge(struct geomag_fit *fit, const struct geomag_fit *other) {
+    for (int i = 0; i < fit->num_params; ++i) {
+        for (int j = i; j < fit->num_params; ++j) {
+            fit->normal[i][j] += other->normal[i][j];
+        }
+        fit->rhs[i] += other->rhs[i];
+    }
+    fit->sum_sq += other->sum_sq;
+    fit->num_obs += other->num_obs;
+}
+
+int geomag_fit_solve(
+    const struct geomag_fit *fit, const real damping, const struct geomag_model *model,
+    struct geomag_model *corrected
+) {
+    const int num_params = fit->num_params;
+    real (*chol)[GEOMAG_FIT_MAX_PARAMS] = malloc(sizeof(real[GEOMAG_FIT_MAX_PARAMS][GEOMAG_FIT_MAX_PARAMS]));
+    real delta[GEOMAG_FIT_MAX_PARAMS];
+    if (chol == NULL) {
+        return -1;
+    }
+
+    // Cholesky factorization, upper triangle U with normal = U^T U
+    for (int i = 0; i < num_params; ++i) {
+        for (int j = i; j < num_params; ++j) {
+            real sum = fit->normal[i][j] + ((i == j) ? damping : 0);
+            for (int k = 0; k < i; ++k) {
+                sum -= chol[k][i] * chol[k][j];
+            }
+            if (i == j) {
+                if (!(sum > 0)) {
+                    free(chol);
+                    return -1;
+                }
+                chol[i][i] = REAL_SQRT(sum);
+            } else {
+                chol[i][j] = sum / chol[i][i];
+            }
+        }
+    }
+    // Forward substitution with U^T, then back substitution with U
+    for (int i = 0; i < num_params; ++i) {
+        real sum = fit->rhs[i];
+        for (int k = 0; k < i; ++k) {
+            sum -= chol[k][i] * delta[k];
+        }
+        delta[i] = sum / chol[i][i];
+    }
+    for (int i = num_params - 1; i >= 0; --i) {
+        real sum = delta[i];
+        for (int k = i + 1; k < num_params; ++k) {
+            sum -= chol[i][k] * delta[k];
+        }
+        delta[i] = sum / chol[i][i];
+    }
+    free(chol);
+
+    if (corrected != model) {
+        *corrected = *model;
+    }
+    for (int p = 0; p < num_params; ++p) {
+        const int col = fit->param_col[p];
+        struct WMM_COEFF_SET *coeff = &corrected->coeffs[col / 2];
+        if (col % 2 == 0) {
+            coeff->main_field_c += delta[p];
+        } else {
+            coeff->main_field_s += delta[p];
+        }
+    }
+    return 0;
+}
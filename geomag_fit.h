@@ -0,0 +1,113 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_FIT_H
+#define GEOMAG_FIT_H
+
+#include "geomag.h"
+
+// Maximum number of fitted coefficients, every one up to `WMM_NMAX`
+#define GEOMAG_FIT_MAX_PARAMS (WMM_NMAX * (WMM_NMAX + 2))
+
+// Number of positions per blocked normal equation update
+#define GEOMAG_FIT_BLOCK 32
+
+// Least-squares accumulator for main field coefficient corrections.
+//
+// Hefty, so allocate statically or on the heap.
+struct geomag_fit {
+    // Highest fitted degree
+    int nmax;
+    int num_params;
+    // Design matrix column of each fitted coefficient
+    int param_col[GEOMAG_FIT_MAX_PARAMS];
+    // Upper triangle of the normal matrix
+    real normal[GEOMAG_FIT_MAX_PARAMS][GEOMAG_FIT_MAX_PARAMS];
+    // Right-hand side [nT]
+    real rhs[GEOMAG_FIT_MAX_PARAMS];
+    // Sum of squared residuals [nT^2]
+    real sum_sq;
+    size_t num_obs;
+    // Scratch rows and residuals of the pending block
+    real block_rows[3 * GEOMAG_FIT_BLOCK][GEOMAG_FIT_MAX_PARAMS];
+    real block_res[3 * GEOMAG_FIT_BLOCK];
+};
+
+// Resets an accumulator for fitting coefficients up to a degree.
+//
+// Args:
+//     nmax: Highest degree to fit, from 1 to `WMM_NMAX`
+//
+// Returns:
+//     fit: Empty accumulator
+void geomag_fit_init(struct geomag_fit *fit, int nmax);
+
+// Adds observations to the normal equations.
+//
+// Residuals are taken against `model`, so the solution is a correction to
+// it. Observations are processed in blocks of `GEOMAG_FIT_BLOCK`, and each
+// block update is split across threads when compiled with OpenMP. Separate
+// accumulators can also be filled independently and combined with
+// `geomag_fit_merge`.
+//
+// Args:
+//     fit: Accumulator
+//     model: Model being corrected
+//     count: Number of observations
+//     dyear: Decimal year of each observation
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//     mag_itrf: Observed magnetic field vectors in ITRF frame [T]
+void geomag_fit_add(
+    struct geomag_fit *fit, const struct geomag_model *model, size_t count, const real *dyear,
+    const real (*pos_itrf)[3], const real (*mag_itrf)[3]
+);
+
+// Adds the normal equations of another accumulator of the same degree.
+//
+// Args:
+//     fit: Accumulator to add into
+//     other: Accumulator to add
+void geomag_fit_merge(struct geomag_fit *fit, const struct geomag_fit *other);
+
+// Solves the normal equations and applies the correction to a model.
+//
+// Only main field coefficients up to `fit->nmax` are corrected, secular
+// variation is kept. `fit` is left unchanged, so more observations can be
+// added and the solve repeated.
+//
+// Args:
+//     fit: Accumulator
+//     damping: Added to the normal matrix diagonal to regularize poorly
+//         covered coefficients, 0 for plain least squares
+//     model: Model the observations were added against
+//
+// Returns:
+//     corrected: Corrected model, may be the same as `model`
+//     0 on success, -1 if the normal equations are singular or out of memory
+int geomag_fit_solve(
+    const struct geomag_fit *fit, real damping, const struct geomag_model *model, struct geomag_model *corrected
+);
+
+#endif // GEOMAG_FIT_H
@@ -0,0 +1,264 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_grid.h"
+#include "stdint.h"
+#include "string.h"
+
+static const real PI = 3.14159265358979323846;
+
+int geomag_grid_stream(
+    const struct geomag_model *model, const real dyear, const size_t num_heights, const real *heights,
+    const size_t num_lats, const real *lats, const size_t num_lons, const real *lons, const size_t tile_rows,
+    const size_t depth, real (*buffer)[3], const geomag_grid_sink sink, void *user
+) {
+    if (depth == 0 || tile_rows == 0) {
+        return -1;
+    }
+    const size_t rows = (tile_rows < num_lats) ? tile_rows : num_lats;
+    const size_t bands = (rows > 0) ? (num_lats + rows - 1) / rows : 0;
+    const size_t num_tiles = num_heights * bands;
+    const size_t tile_len = rows * num_lons;
+    int failed = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+    {
+#ifdef _OPENMP
+        // Dependence token keeping the sink calls in order
+        int order = 0;
+        (void) order;
+#endif
+        for (size_t k = 0; k < num_tiles; ++k) {
+            real (*slot)[3] = buffer + (k % depth) * tile_len;
+            const size_t h = k / bands;
+            const size_t lat0 = (k % bands) * rows;
+            const size_t num_rows = (lat0 + rows < num_lats) ? rows : num_lats - lat0;
+            // A slot is reused once the sink is done with its previous tile
+#ifdef _OPENMP
+#pragma omp task depend(inout: slot[0]) shared(failed)
+#endif
+            {
+                int stop;
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+                stop = failed;
+                for (size_t i = 0; i < num_rows && !stop; ++i) {
+                    geomag_grid_row(model, dyear, lats[lat0 + i], heights[h], num_lons, lons, &slot[i * num_lons]);
+                }
+            }
+#ifdef _OPENMP
+#pragma omp task depend(in: slot[0]) depend(inout: order) shared(failed)
+#endif
+            {
+                int stop;
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+                stop = failed;
+                if (!stop && sink(user, h, lat0, num_rows, num_lons, (const real (*)[3]) slot) != 0) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+                    failed = 1;
+                }
+            }
+        }
+    }
+    return failed ? -1 : 0;
+}
+
+// NetCDF classic tags and types
+enum {
+    NC_DIMENSION = 10,
+    NC_VARIABLE = 11,
+    NC_ATTRIBUTE = 12,
+    NC_CHAR = 2,
+    NC_DOUBLE = 6
+};
+
+// Header under construction, big-endian as NetCDF requires
+struct nc_header {
+    unsigned char *bytes;
+    size_t len;
+};
+
+static void put_u32(struct nc_header *h, const uint32_t value) {
+    for (int i = 3; i >= 0; --i) {
+        if (h->bytes != NULL) {
+            h->bytes[h->len] = (unsigned char) (value >> (8 * i));
+        }
+        ++h->len;
+    }
+}
+
+static void put_u64(struct nc_header *h, const uint64_t value) {
+    put_u32(h, (uint32_t) (value >> 32));
+    put_u32(h, (uint32_t) value);
+}
+
+static void put_double(unsigned char *bytes, const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = (unsigned char) (bits >> (8 * (7 - i)));
+    }
+}
+
+// Name, padded to four bytes
+static void put_name(struct nc_header *h, const char *name) {
+    const size_t len = strlen(name);
+    put_u32(h, (uint32_t) len);
+    for (size_t i = 0; i < (len + 3) / 4 * 4; ++i) {
+        if (h->bytes != NULL) {
+            h->bytes[h->len] = (i < len) ? (unsigned char) name[i] : 0;
+        }
+        ++h->len;
+    }
+}
+
+// Variable attributes with just `units`
+static void put_units(struct nc_header *h, const char *units) {
+    put_u32(h, NC_ATTRIBUTE);
+    put_u32(h, 1);
+    put_name(h, "units");
+    put_u32(h, NC_CHAR);
+    put_name(h, units);
+}
+
+// Lays out the header, measuring only if `h->bytes` is NULL
+static void build_header(
+    struct nc_header *h, const real dyear, const size_t dims[4], const uint64_t data_begin
+) {
+    static const char *const DIM_NAMES[4] = {"height", "lat", "lon", "component"};
+    static const char *const UNITS[3] = {"m", "degrees_north", "degrees_east"};
+    h->len = 0;
+    // "CDF" and version 2, the 64-bit offset format
+    put_u32(h, 0x43444602);
+    // No record dimension, so no records
+    put_u32(h, 0);
+    put_u32(h, NC_DIMENSION);
+    put_u32(h, 4);
+    for (int i = 0; i < 4; ++i) {
+        put_name(h, DIM_NAMES[i]);
+        put_u32(h, (uint32_t) dims[i]);
+    }
+    put_u32(h, NC_ATTRIBUTE);
+    put_u32(h, 1);
+    put_name(h, "dyear");
+    put_u32(h, NC_DOUBLE);
+    put_u32(h, 1);
+    if (h->bytes != NULL) {
+        put_double(h->bytes + h->len, (double) dyear);
+    }
+    h->len += 8;
+
+    put_u32(h, NC_VARIABLE);
+    put_u32(h, 4);
+    uint64_t begin = data_begin;
+    for (int i = 0; i < 3; ++i) {
+        put_name(h, DIM_NAMES[i]);
+        put_u32(h, 1);
+        put_u32(h, (uint32_t) i);
+        put_units(h, UNITS[i]);
+        put_u32(h, NC_DOUBLE);
+        put_u32(h, (uint32_t) (dims[i] * 8));
+        put_u64(h, begin);
+        begin += dims[i] * 8;
+    }
+    put_name(h, "b");
+    put_u32(h, 4);
+    for (uint32_t i = 0; i < 4; ++i) {
+        put_u32(h, i);
+    }
+    put_units(h, "T");
+    put_u32(h, NC_DOUBLE);
+    // The last variable may exceed the 32-bit size, which is then saturated
+    const uint64_t size = (uint64_t) dims[0] * dims[1] * dims[2] * dims[3] * 8;
+    put_u32(h, (size < UINT32_MAX) ? (uint32_t) size : UINT32_MAX);
+    put_u64(h, begin);
+}
+
+// Writes an axis as big-endian doubles, scaled
+static int write_axis(FILE *file, const size_t count, const real *axis, const real scale) {
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char bytes[8];
+        put_double(bytes, (double) (axis[i] * scale));
+        if (fwrite(bytes, 1, 8, file) != 8) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int geomag_grid_netcdf_begin(
+    FILE *file, const real dyear, const size_t num_heights, const real *heights, const size_t num_lats,
+    const real *lats, const size_t num_lons, const real *lons
+) {
+    const size_t dims[4] = {num_heights, num_lats, num_lons, 3};
+    unsigned char bytes[1024];
+    struct nc_header h = {NULL, 0};
+    build_header(&h, dyear, dims, 0);
+    if (h.len > sizeof(bytes)) {
+        return -1;
+    }
+    const size_t len = h.len;
+    h.bytes = bytes;
+    build_header(&h, dyear, dims, len);
+    if (fwrite(bytes, 1, len, file) != len) {
+        return -1;
+    }
+    if (write_axis(file, num_heights, heights, 1) != 0 || write_axis(file, num_lats, lats, 180 / PI) != 0
+        || write_axis(file, num_lons, lons, 180 / PI) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int geomag_grid_netcdf_sink(
+    void *file, const size_t height_index, const size_t lat_index, const size_t num_rows, const size_t num_lons,
+    const real (*mag_itrf)[3]
+) {
+    (void) height_index;
+    (void) lat_index;
+    // Converted 64 vectors at a time to stay in constant memory
+    unsigned char bytes[3 * 8 * 64];
+    const size_t count = num_rows * num_lons;
+    for (size_t start = 0; start < count; start += 64) {
+        const size_t n = (count - start < 64) ? count - start : 64;
+        for (size_t i = 0; i < n; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                put_double(bytes + 8 * (3 * i + (size_t) k), (double) mag_itrf[start + i][k]);
+            }
+        }
+        if (fwrite(bytes, 1, 24 * n, (FILE *) file) != 24 * n) {
+            return -1;
+        }
+    }
+    return 0;
+}
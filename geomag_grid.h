@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_GRID_H
+#define GEOMAG_GRID_H
+
+#include <stdio.h>
+
+#include "geomag.h"
+
+// Receives a finished tile of grid rows.
+//
+// Tiles arrive in output order, by height, then latitude. A tile is
+// `num_rows` consecutive latitudes at one height, each row holding
+// `num_lons` vectors, and is only valid during the call.
+//
+// Args:
+//     user: Pointer passed through from `geomag_grid_stream`
+//     height_index: Index of the tile's height
+//     lat_index: Index of the tile's first latitude
+//     num_rows: Number of latitudes in the tile
+//     num_lons: Number of longitudes per row
+//     mag_itrf: `num_rows * num_lons` magnetic field vectors in ITRF frame [T]
+//
+// Returns:
+//     0 to continue, anything else to stop the stream
+typedef int (*geomag_grid_sink)(
+    void *user, size_t height_index, size_t lat_index, size_t num_rows, size_t num_lons, const real (*mag_itrf)[3]
+);
+
+// Computes a geodetic grid tile by tile, handing each tile to a sink.
+//
+// Works like `geomag_grid` in constant memory, the caller's buffer of
+// `depth` tiles. When compiled with OpenMP, tiles are computed as tasks
+// into free buffer slots while the sink consumes finished ones in order,
+// so up to `depth - 1` tiles are computed while the sink writes. Without
+// OpenMP, tiles are computed and sunk in turn.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     num_heights: Number of heights
+//     heights: Heights above the WGS 84 ellipsoid [m]
+//     num_lats: Number of latitudes
+//     lats: WGS 84 geodetic latitudes [rad]
+//     num_lons: Number of longitudes
+//     lons: Longitudes [rad]
+//     tile_rows: Latitude rows per tile, at least 1
+//     depth: Number of tiles in the buffer, at least 1
+//     buffer: Storage for `depth * tile_rows * num_lons` vectors
+//     sink: Receives each tile
+//     user: Passed to `sink`
+//
+// Returns:
+//     0 once every tile is sunk, -1 if the sink stopped the stream or
+//     `tile_rows` or `depth` is 0
+int geomag_grid_stream(
+    const struct geomag_model *model, real dyear, size_t num_heights, const real *heights, size_t num_lats,
+    const real *lats, size_t num_lons, const real *lons, size_t tile_rows, size_t depth, real (*buffer)[3],
+    geomag_grid_sink sink, void *user
+);
+
+// Starts a NetCDF classic file for a streamed grid.
+//
+// Writes a 64-bit offset NetCDF classic header and the axes, leaving the
+// file positioned for `geomag_grid_netcdf_sink`. The file has dimensions
+// `height`, `lat`, `lon` and `component`, coordinate variables `height` [m],
+// `lat` and `lon` [degrees], the field `b(height, lat, lon, component)` in
+// ITRF frame [T], and the decimal year as global attribute `dyear`.
+//
+// Args:
+//     file: File open for binary writing, at its start
+//     dyear: Decimal year
+//     num_heights: Number of heights
+//     heights: Heights above the WGS 84 ellipsoid [m]
+//     num_lats: Number of latitudes
+//     lats: WGS 84 geodetic latitudes [rad]
+//     num_lons: Number of longitudes
+//     lons: Longitudes [rad]
+//
+// Returns:
+//     0 on success, -1 on a write error
+int geomag_grid_netcdf_begin(
+    FILE *file, real dyear, size_t num_heights, const real *heights, size_t num_lats, const real *lats,
+    size_t num_lons, const real *lons
+);
+
+// Sink appending tiles to a file started by `geomag_grid_netcdf_begin`.
+//
+// Pass the `FILE *` as the user pointer. Stops the stream on a write error.
+int geomag_grid_netcdf_sink(
+    void *file, size_t height_index, size_t lat_index, size_t num_rows, size_t num_lons, const real (*mag_itrf)[3]
+);
+
+#endif // GEOMAG_GRID_H
@@ -0,0 +1,200 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_lshell.h"
+#include "geomag_trace.h"
+#include "math.h"
+
+// Mean radius of ellipsoid, the unit of L
+static const real EARTH_R = 6371200.0;
+
+// Lines reaching this radius are lost to the atmosphere [m]
+static const real LSHELL_R_LOST = 6371200.0 + 100000.0;
+
+// Tolerance on the position error of each trace step [m]
+static const real LSHELL_TOL = 10;
+
+// Hilton (1971) approximation of McIlwain's function,
+// L^3 Bm / M = 1 + a1 X^(1/3) + a2 X^(2/3) + a3 X with X = I^3 Bm / M
+static const real HILTON_A[3] = {1.35047, 0.465376, 0.0475455};
+
+void geomag_lshell_cache_init(
+    struct geomag_lshell_cache *cache, struct geomag_lshell_cache_entry *entries, const size_t capacity,
+    const real cell, const real dyear_tol
+) {
+    cache->cell = cell;
+    cache->dyear_tol = dyear_tol;
+    cache->capacity = capacity;
+    cache->entries = entries;
+    cache->hits = 0;
+    cache->misses = 0;
+    for (size_t i = 0; i < capacity; ++i) {
+        entries[i].valid = 0;
+    }
+}
+
+static real norm(const real v[3]) {
+    return REAL_SQRT(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+// Dipole moment of the model [nT Earth radii^3]
+static real dipole_moment(const struct geomag_model *model, const real dyear) {
+    real coeffs[GEOMAG_DESIGN_COLS];
+    geomag_model_coeffs(model, dyear, coeffs, 1);
+    // n = 1 terms are at indices 1 and 1 + WMM_NMAX, un-normalization is 1
+    const real g10 = coeffs[2 * 1];
+    const real g11 = coeffs[2 * (1 + WMM_NMAX)];
+    const real h11 = coeffs[2 * (1 + WMM_NMAX) + 1];
+    return REAL_SQRT(g10 * g10 + g11 * g11 + h11 * h11);
+}
+
+// Cache slot and cell of a position
+static struct geomag_lshell_cache_entry *cache_slot(
+    const struct geomag_lshell_cache *cache, const real (*pos_itrf)[3], long cell[3]
+) {
+    unsigned long hash = 0;
+    static const unsigned long PRIMES[3] = {73856093UL, 19349663UL, 83492791UL};
+    for (int i = 0; i < 3; ++i) {
+        cell[i] = (long) REAL_FLOOR((*pos_itrf)[i] / cache->cell);
+        hash ^= (unsigned long) cell[i] * PRIMES[i];
+    }
+    return &cache->entries[hash % cache->capacity];
+}
+
+// Traces the line and fills in L, B0 and the status
+static void compute_lshell(
+    const struct geomag_model *model, const real dyear, const real (*pos_itrf)[3], struct geomag_lshell *lshell
+) {
+    struct geomag_jet jet;
+    geomag_jet(model, dyear, pos_itrf, 1, &jet);
+    const real b = norm(jet.mag);
+    lshell->b = b;
+    lshell->l = 0;
+    lshell->b0 = b;
+    lshell->status = GEOMAG_LSHELL_FAILED;
+    if (!(b > 0)) {
+        return;
+    }
+
+    // Head towards decreasing |B|, d|B|/ds = b . grad(B) . b along B
+    real rate = 0;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            rate += jet.mag[i] * jet.grad[i][j] * jet.mag[j];
+        }
+    }
+    struct geomag_trace_opts opts;
+    geomag_trace_opts_default(&opts, dyear);
+    opts.direction = (rate > 0) ? -1 : 1;
+    opts.r_stop = LSHELL_R_LOST;
+    opts.b_mirror = b;
+    opts.tol = LSHELL_TOL;
+    struct geomag_trace_result result;
+    geomag_trace(model, &opts, pos_itrf, NULL, 0, &result);
+    lshell->b0 = result.b_min;
+
+    if (result.stop == GEOMAG_TRACE_ALTITUDE && result.b_min < b) {
+        lshell->status = GEOMAG_LSHELL_LOST;
+        return;
+    }
+    if (result.stop != GEOMAG_TRACE_MIRROR && result.stop != GEOMAG_TRACE_ALTITUDE) {
+        return;
+    }
+    // Otherwise the position is the minimum itself, and I is 0
+    const real moment = dipole_moment(model, dyear);
+    const real b_nt = b / REAL_NT2T;
+    const real integral = (result.stop == GEOMAG_TRACE_MIRROR) ? result.integral / EARTH_R : 0;
+    const real x_cbrt = integral * REAL_POW(b_nt / moment, ((real) 1) / 3);
+    const real f = 1 + x_cbrt * (HILTON_A[0] + x_cbrt * (HILTON_A[1] + x_cbrt * HILTON_A[2]));
+    lshell->l = REAL_POW(moment / b_nt * f, ((real) 1) / 3);
+    lshell->status = GEOMAG_LSHELL_OK;
+}
+
+void geomag_lshell(
+    const struct geomag_model *model, const real dyear, const real (*pos_itrf)[3],
+    struct geomag_lshell_cache *cache, struct geomag_lshell *lshell
+) {
+    if (cache == NULL || cache->capacity == 0) {
+        compute_lshell(model, dyear, pos_itrf, lshell);
+        lshell->b_ratio = lshell->b / lshell->b0;
+        return;
+    }
+
+    long cell[3];
+    struct geomag_lshell_cache_entry *slot = cache_slot(cache, pos_itrf, cell);
+    struct geomag_lshell_cache_entry entry;
+    int hit;
+#ifdef _OPENMP
+#pragma omp critical(geomag_lshell_cache)
+#endif
+    {
+        entry = *slot;
+        hit = entry.valid && entry.cell[0] == cell[0] && entry.cell[1] == cell[1] && entry.cell[2] == cell[2]
+            && REAL_FABS(entry.dyear - dyear) <= cache->dyear_tol;
+        if (hit) {
+            ++cache->hits;
+        } else {
+            ++cache->misses;
+        }
+    }
+
+    if (hit) {
+        real mag[3];
+        geomag_eval(model, dyear, pos_itrf, &mag);
+        lshell->b = norm(mag);
+        lshell->l = entry.l;
+        lshell->b0 = entry.b0;
+        lshell->status = entry.status;
+    } else {
+        compute_lshell(model, dyear, pos_itrf, lshell);
+        for (int i = 0; i < 3; ++i) {
+            entry.cell[i] = cell[i];
+        }
+        entry.dyear = dyear;
+        entry.l = lshell->l;
+        entry.b0 = lshell->b0;
+        entry.status = lshell->status;
+        entry.valid = 1;
+#ifdef _OPENMP
+#pragma omp critical(geomag_lshell_cache)
+#endif
+        {
+            *slot = entry;
+        }
+    }
+    lshell->b_ratio = lshell->b / lshell->b0;
+}
+
+void geomag_lshell_batch(
+    const struct geomag_model *model, const size_t count, const real *dyear, const real (*pos_itrf)[3],
+    struct geomag_lshell_cache *cache, struct geomag_lshell *lshell
+) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_lshell(model, dyear[i], &pos_itrf[i], cache, &lshell[i]);
+    }
+}
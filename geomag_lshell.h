@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_LSHELL_H
+#define GEOMAG_LSHELL_H
+
+#include "geomag.h"
+
+// Outcome of an L-shell computation
+enum geomag_lshell_status {
+    GEOMAG_LSHELL_OK,
+    // The field line reaches the atmosphere before the mirror point, so a
+    // particle mirroring here is lost and L is undefined
+    GEOMAG_LSHELL_LOST,
+    // Tracing failed
+    GEOMAG_LSHELL_FAILED
+};
+
+// McIlwain L-shell of a particle mirroring at a position
+struct geomag_lshell {
+    // McIlwain L, 0 unless `status` is `GEOMAG_LSHELL_OK` [Earth radii]
+    real l;
+    // Field magnitude at the position, the mirror field [T]
+    real b;
+    // Smallest field magnitude along the field line [T]
+    real b0;
+    // b / b0
+    real b_ratio;
+    enum geomag_lshell_status status;
+};
+
+// Entry of an L-shell cache
+struct geomag_lshell_cache_entry {
+    long cell[3];
+    real dyear;
+    real l;
+    real b0;
+    enum geomag_lshell_status status;
+    int valid;
+};
+
+// Spatial table of L-shell results, reused for positions in the same cell.
+//
+// A cell's L and B0 are those of the first position computed in it, so
+// the cell size trades accuracy for hits. B at each position is always
+// evaluated exactly.
+struct geomag_lshell_cache {
+    // Cell edge length [m]
+    real cell;
+    // Largest epoch difference to reuse an entry for [yr]
+    real dyear_tol;
+    size_t capacity;
+    struct geomag_lshell_cache_entry *entries;
+    size_t hits;
+    size_t misses;
+};
+
+// Initializes an empty cache over caller provided entries.
+//
+// Args:
+//     entries: Storage for `capacity` entries
+//     capacity: Number of entries, a direct mapped hash table
+//     cell: Cell edge length [m]
+//     dyear_tol: Largest epoch difference to reuse an entry for [yr]
+//
+// Returns:
+//     cache: Empty cache
+void geomag_lshell_cache_init(
+    struct geomag_lshell_cache *cache, struct geomag_lshell_cache_entry *entries, size_t capacity,
+    real cell, real dyear_tol
+);
+
+// Computes McIlwain L and B/B0 for a particle mirroring at a position.
+//
+// Traces the field line from the position towards decreasing |B| and
+// stops at the conjugate mirror point, integrating
+// I = integral of sqrt(1 - B / Bm) ds along the way and picking up the
+// minimum B0. L follows from I, Bm and the dipole moment of the model by
+// Hilton's approximation of McIlwain's function. Lines that reach 100 km
+// altitude first are reported as lost.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//     cache: Optional cache of nearby results, or NULL
+//
+// Returns:
+//     lshell: L-shell and field magnitudes
+void geomag_lshell(
+    const struct geomag_model *model, real dyear, const real (*pos_itrf)[3], struct geomag_lshell_cache *cache,
+    struct geomag_lshell *lshell
+);
+
+// Computes McIlwain L and B/B0 for a batch of positions.
+//
+// Positions are split across threads when compiled with OpenMP, sharing
+// the cache.
+//
+// Args:
+//     model: Magnetic field model
+//     count: Number of positions
+//     dyear: Decimal year of each position
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//     cache: Optional cache of nearby results, or NULL
+//
+// Returns:
+//     lshell: L-shell and field magnitudes at each position
+void geomag_lshell_batch(
+    const struct geomag_model *model, size_t count, const real *dyear, const real (*pos_itrf)[3],
+    struct geomag_lshell_cache *cache, struct geomag_lshell *lshell
+);
+
+#endif // GEOMAG_LSHELL_H
@@ -0,0 +1,209 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_poles.h"
+#include "math.h"
+
+// Newton iterations before giving up
+static const int POLE_MAX_ITER = 50;
+static const int EQUATOR_MAX_ITER = 30;
+
+// Largest pole step [m] and dip equator step [rad], to stay in the basin
+static const real POLE_MAX_STEP = 500000;
+static const real EQUATOR_MAX_STEP = 0.1;
+
+// Converged once the step falls below this [m], [rad]
+static const real POLE_TOL = 1e-4;
+static const real EQUATOR_TOL = 1e-11;
+
+// Longitudes marched from one starting guess
+#define EQUATOR_CHUNK 16
+
+static real dot(const real a[3], const real b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void mat_vec(const real (*m)[3], const real v[3], real out[3]) {
+    for (int i = 0; i < 3; ++i) {
+        out[i] = dot(m[i], v);
+    }
+}
+
+// Unit vector along the dipole moment, pointing to the south geomagnetic pole
+static void dipole_axis(const struct geomag_model *model, const real dyear, real axis[3]) {
+    real coeffs[GEOMAG_DESIGN_COLS];
+    geomag_model_coeffs(model, dyear, coeffs, 1);
+    // n = 1 terms are at indices 1 and 1 + WMM_NMAX, un-normalization is 1
+    axis[0] = coeffs[2 * (1 + WMM_NMAX)];
+    axis[1] = coeffs[2 * (1 + WMM_NMAX) + 1];
+    axis[2] = coeffs[2 * 1];
+    const real norm = REAL_SQRT(dot(axis, axis));
+    for (int i = 0; i < 3; ++i) {
+        axis[i] /= norm;
+    }
+}
+
+// Latitude of the dipole equator, where the axis is normal to the radius
+static real dipole_equator(const real axis[3], const real lon) {
+    const real along = axis[0] * REAL_COS(lon) + axis[1] * REAL_SIN(lon);
+    return (axis[2] > 0) ? REAL_ATAN2(-along, axis[2]) : REAL_ATAN2(along, -axis[2]);
+}
+
+int geomag_dip_pole(
+    const struct geomag_model *model, const real dyear, const real height,
+    const enum geomag_pole_hemisphere hemisphere, struct geomag_pole *pole
+) {
+    real axis[3];
+    dipole_axis(model, dyear, axis);
+    const real sign = (hemisphere == GEOMAG_POLE_NORTH) ? -1 : 1;
+    real lat = REAL_ATAN2(sign * axis[2], REAL_SQRT(axis[0] * axis[0] + axis[1] * axis[1]));
+    real lon = REAL_ATAN2(sign * axis[1], sign * axis[0]);
+
+    int converged = 0;
+    int iter = 0;
+    while (!converged && iter < POLE_MAX_ITER) {
+        ++iter;
+        real pos[3], ned[3][3];
+        struct geomag_jet jet;
+        geomag_geodetic_to_itrf(lat, lon, height, &pos);
+        geomag_ned_frame(lat, lon, ned);
+        geomag_jet(model, dyear, (const real (*)[3]) &pos, 1, &jet);
+
+        // Horizontal field f_i = B . t_i, where the tangent vectors t_i turn
+        // towards the normal as they are transported, by 1 / r per metre
+        const real b_up = -dot(ned[2], jet.mag);
+        const real curvature = b_up / REAL_SQRT(dot(pos, pos));
+        real f[2], jac[2][2];
+        for (int j = 0; j < 2; ++j) {
+            real grad_t[3];
+            mat_vec((const real (*)[3]) jet.grad, ned[j], grad_t);
+            f[j] = dot(ned[j], jet.mag);
+            for (int i = 0; i < 2; ++i) {
+                jac[i][j] = dot(ned[i], grad_t) - ((i == j) ? curvature : 0);
+            }
+        }
+        const real det = jac[0][0] * jac[1][1] - jac[0][1] * jac[1][0];
+        if (det == 0) {
+            return -1;
+        }
+        real step[2] = {
+            (jac[0][1] * f[1] - jac[1][1] * f[0]) / det,
+            (jac[1][0] * f[0] - jac[0][0] * f[1]) / det
+        };
+        const real step_norm = REAL_SQRT(step[0] * step[0] + step[1] * step[1]);
+        if (step_norm > POLE_MAX_STEP) {
+            step[0] *= POLE_MAX_STEP / step_norm;
+            step[1] *= POLE_MAX_STEP / step_norm;
+        }
+        for (int i = 0; i < 3; ++i) {
+            pos[i] += step[0] * ned[0][i] + step[1] * ned[1][i];
+        }
+        real h;
+        geomag_itrf_to_geodetic((const real (*)[3]) &pos, &lat, &lon, &h);
+        converged = step_norm < POLE_TOL;
+    }
+
+    real ned[3][3], mag[3];
+    geomag_geodetic_to_itrf(lat, lon, height, &pole->pos_itrf);
+    geomag_ned_frame(lat, lon, ned);
+    geomag_eval(model, dyear, (const real (*)[3]) &pole->pos_itrf, &mag);
+    const real b_north = dot(ned[0], mag), b_east = dot(ned[1], mag);
+    pole->lat = lat;
+    pole->lon = lon;
+    pole->residual = REAL_SQRT(b_north * b_north + b_east * b_east);
+    pole->iterations = iter;
+    // Both poles are roots, so check this is the one asked for
+    const real b_down = dot(ned[2], mag);
+    if (!converged || ((hemisphere == GEOMAG_POLE_NORTH) != (b_down > 0))) {
+        return -1;
+    }
+    return 0;
+}
+
+// Solves for the dip equator latitude at a longitude, starting from `lat`
+static int equator_solve(
+    const struct geomag_model *model, const real dyear, const real height, const real lon, real *lat
+) {
+    for (int iter = 0; iter < EQUATOR_MAX_ITER; ++iter) {
+        real pos[3], ned[3][3], grad_n[3];
+        struct geomag_jet jet;
+        geomag_geodetic_to_itrf(*lat, lon, height, &pos);
+        geomag_ned_frame(*lat, lon, ned);
+        geomag_jet(model, dyear, (const real (*)[3]) &pos, 1, &jet);
+        mat_vec((const real (*)[3]) jet.grad, ned[0], grad_n);
+
+        // Vertical field g = B . up, where d(pos)/d(lat) = (M + h) north with
+        // M the meridian radius of curvature, and d(up)/d(lat) = north
+        const real sin_lat = REAL_SIN(*lat);
+        const real w = 1 - GEOMAG_WGS84_E2 * sin_lat * sin_lat;
+        const real meridian = GEOMAG_WGS84_A * (1 - GEOMAG_WGS84_E2) / (w * REAL_SQRT(w));
+        const real g = -dot(ned[2], jet.mag);
+        const real dg = -(meridian + height) * dot(ned[2], grad_n) + dot(ned[0], jet.mag);
+        if (dg == 0) {
+            return -1;
+        }
+        real step = -g / dg;
+        if (REAL_FABS(step) > EQUATOR_MAX_STEP) {
+            step = (step > 0) ? EQUATOR_MAX_STEP : -EQUATOR_MAX_STEP;
+        }
+        *lat += step;
+        if (REAL_FABS(step) < EQUATOR_TOL) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int geomag_dip_equator(
+    const struct geomag_model *model, const real dyear, const real height, const size_t count, const real *lon,
+    real *lat
+) {
+    real axis[3];
+    dipole_axis(model, dyear, axis);
+    const size_t num_chunks = (count + EQUATOR_CHUNK - 1) / EQUATOR_CHUNK;
+    int failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(|:failed)
+#endif
+    for (size_t c = 0; c < num_chunks; ++c) {
+        const size_t end = (c + 1) * EQUATOR_CHUNK < count ? (c + 1) * EQUATOR_CHUNK : count;
+        for (size_t i = c * EQUATOR_CHUNK; i < end; ++i) {
+            const int first = (i == c * EQUATOR_CHUNK);
+            lat[i] = first ? dipole_equator(axis, lon[i]) : lat[i - 1];
+            if (equator_solve(model, dyear, height, lon[i], &lat[i]) == 0) {
+                continue;
+            }
+            // Retry from the dipole equator, unless that was the guess already,
+            // and keep the failed iterate if the retry fails too
+            real retry = dipole_equator(axis, lon[i]);
+            if (!first && equator_solve(model, dyear, height, lon[i], &retry) == 0) {
+                lat[i] = retry;
+            } else {
+                failed = 1;
+            }
+        }
+    }
+    return failed ? -1 : 0;
+}
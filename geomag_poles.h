@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_POLES_H
+#define GEOMAG_POLES_H
+
+#include "geomag.h"
+
+// Which of the two dip poles to locate
+enum geomag_pole_hemisphere {
+    // Inclination +90 degrees, the field points down
+    GEOMAG_POLE_NORTH,
+    // Inclination -90 degrees, the field points up
+    GEOMAG_POLE_SOUTH
+};
+
+// Dip pole, where the field is normal to the ellipsoid
+struct geomag_pole {
+    // Geodetic latitude [rad]
+    real lat;
+    // Longitude [rad]
+    real lon;
+    // ECEF position vector in ITRF frame [m]
+    real pos_itrf[3];
+    // Horizontal field magnitude left at `pos_itrf` [T]
+    real residual;
+    // Number of Newton iterations taken
+    int iterations;
+};
+
+// Locates a dip pole at a height above the ellipsoid.
+//
+// Runs Newton's method on the horizontal field in the tangent plane, with
+// the Jacobian from the analytic field gradient. Steps are taken in a local
+// tangent frame rather than latitude and longitude, so iterates can pass
+// over the geographic poles. Starts from the pole of the model's dipole
+// axis, which is within a few hundred kilometres.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     height: Height above the WGS 84 ellipsoid [m]
+//     hemisphere: Which pole to locate
+//
+// Returns:
+//     pole: Position of the pole
+//     0 on success, -1 if Newton's method did not converge to that pole
+int geomag_dip_pole(
+    const struct geomag_model *model, real dyear, real height, enum geomag_pole_hemisphere hemisphere,
+    struct geomag_pole *pole
+);
+
+// Traces the dip equator, where inclination is zero, across longitudes.
+//
+// Solves for the latitude at each longitude by Newton's method on the
+// vertical field, with the exact derivative along the meridian. Longitudes
+// are marched in fixed size chunks, each solve starting from the previous
+// latitude in its chunk and the first from the dipole equator. Chunks are
+// split across threads when compiled with OpenMP, and the result does not
+// depend on the number of threads.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     height: Height above the WGS 84 ellipsoid [m]
+//     count: Number of longitudes, ideally ordered so that neighbours are close
+//     lon: Longitudes [rad]
+//
+// Returns:
+//     lat: Geodetic latitude of the dip equator at each longitude [rad]
+//     0 on success, -1 if any solve did not converge, leaving its last iterate
+int geomag_dip_equator(
+    const struct geomag_model *model, real dyear, real height, size_t count, const real *lon, real *lat
+);
+
+#endif // GEOMAG_POLES_H
@@ -0,0 +1,104 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_swap.h"
+#include "stdatomic.h"
+#include "stdlib.h"
+
+// Publishes yield while waiting on readers, where C11 threads exist
+#ifndef __STDC_NO_THREADS__
+#include "threads.h"
+#define WAIT() thrd_yield()
+#else
+#define WAIT() ((void) 0)
+#endif
+
+// Size of a cache line, to keep the counters apart [bytes]
+#define LINE_SIZE 64
+
+struct geomag_model_slot {
+    _Atomic(const struct geomag_model *) model;
+    // Publishes so far, the low bit picks the counter new holds use
+    atomic_uint phase;
+    // Set while a publish is underway
+    atomic_flag publishing;
+    // Holds counted in each phase, on lines of their own as every reader
+    // writes them
+    struct {
+        _Alignas(LINE_SIZE) atomic_size_t count;
+    } holds[2];
+};
+
+struct geomag_model_slot *geomag_model_slot_new(const struct geomag_model *model) {
+    struct geomag_model_slot *slot = aligned_alloc(LINE_SIZE, sizeof(struct geomag_model_slot));
+    if (slot == NULL) {
+        return NULL;
+    }
+    atomic_init(&slot->model, model);
+    atomic_init(&slot->phase, 0);
+    atomic_flag_clear(&slot->publishing);
+    atomic_init(&slot->holds[0].count, 0);
+    atomic_init(&slot->holds[1].count, 0);
+    return slot;
+}
+
+void geomag_model_slot_free(struct geomag_model_slot *slot) {
+    free(slot);
+}
+
+void geomag_model_acquire(struct geomag_model_slot *slot, struct geomag_model_hold *hold) {
+    for (;;) {
+        const unsigned phase = atomic_load(&slot->phase);
+        atomic_fetch_add(&slot->holds[phase & 1].count, 1);
+        // Counted before the phase moved on, so a publish waits for this hold
+        if (atomic_load(&slot->phase) == phase) {
+            hold->phase = phase & 1;
+            break;
+        }
+        atomic_fetch_sub(&slot->holds[phase & 1].count, 1);
+    }
+    hold->model = atomic_load(&slot->model);
+}
+
+void geomag_model_release(struct geomag_model_slot *slot, const struct geomag_model_hold *hold) {
+    atomic_fetch_sub_explicit(&slot->holds[hold->phase].count, 1, memory_order_release);
+}
+
+const struct geomag_model *geomag_model_publish(
+    struct geomag_model_slot *slot, const struct geomag_model *model
+) {
+    while (atomic_flag_test_and_set_explicit(&slot->publishing, memory_order_acquire)) {
+        WAIT();
+    }
+    const struct geomag_model *old = atomic_exchange(&slot->model, model);
+    // Holds from here on count in the other phase and see the new model, so
+    // only those of the old phase can have the old model
+    const unsigned phase = atomic_fetch_add(&slot->phase, 1);
+    while (atomic_load_explicit(&slot->holds[phase & 1].count, memory_order_acquire) != 0) {
+        WAIT();
+    }
+    atomic_flag_clear_explicit(&slot->publishing, memory_order_release);
+    return old;
+}
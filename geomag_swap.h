@@ -0,0 +1,93 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_SWAP_H
+#define GEOMAG_SWAP_H
+
+#include "geomag.h"
+
+// Published model that can be replaced while it is in use.
+//
+// Readers hold the model for the length of an evaluation without taking a
+// lock, and a writer publishing a replacement waits, read-copy-update
+// style, for the evaluations already holding the old model to finish, after
+// which the old model can be freed. Evaluations started after the publish
+// see the new model.
+//
+// Readers touch only two counters, one per phase, which each publish
+// alternates between, so a steady stream of readers cannot hold a writer
+// off. Built on C11 atomics, so this file is compiled with -std=c11 while
+// its header stays usable from C99 and C++.
+struct geomag_model_slot;
+
+// A reader's hold on the published model
+struct geomag_model_hold {
+    const struct geomag_model *model;
+    // Phase the hold was counted in
+    unsigned phase;
+};
+
+// Creates a slot publishing a model.
+//
+// Args:
+//     model: Initial model, which must outlive its publication
+//
+// Returns:
+//     New slot, or NULL if out of memory
+struct geomag_model_slot *geomag_model_slot_new(const struct geomag_model *model);
+
+// Frees a slot with no holds left. The published model is not freed.
+void geomag_model_slot_free(struct geomag_model_slot *slot);
+
+// Holds the published model, never blocking.
+//
+// Args:
+//     slot: Slot to read
+//
+// Returns:
+//     hold: The model, valid until `geomag_model_release`
+void geomag_model_acquire(struct geomag_model_slot *slot, struct geomag_model_hold *hold);
+
+// Ends a hold from `geomag_model_acquire`.
+void geomag_model_release(struct geomag_model_slot *slot, const struct geomag_model_hold *hold);
+
+// Publishes a new model and waits until the old one is no longer held.
+//
+// Publishes from several threads are serialized. The wait spins, yielding
+// where C11 threads are available, and lasts as long as the longest hold
+// started before the publish, so holds should be short, such as one batch.
+// A thread must not publish while it holds the slot itself.
+//
+// Args:
+//     slot: Slot to update
+//     model: New model, which must outlive its publication
+//
+// Returns:
+//     The previous model, which no reader holds anymore
+const struct geomag_model *geomag_model_publish(
+    struct geomag_model_slot *slot, const struct geomag_model *model
+);
+
+#endif // GEOMAG_SWAP_H
@@ -0,0 +1,273 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_table.h"
+#include "math.h"
+#include "stdint.h"
+#include "string.h"
+
+static const real PI = 3.14159265358979323846;
+
+static const char TABLE_MAGIC[8] = {'G', 'M', 'T', 'A', 'B', 'L', 'E', '\0'};
+
+// Start of a table, followed by the epoch, height, latitude and longitude
+// axes, then the field from `data_offset`
+struct table_header {
+    char magic[8];
+    uint32_t version;
+    // Written as 1, so a table from a host of the other byte order fails
+    uint32_t byte_order;
+    uint32_t real_size;
+    uint32_t reserved;
+    // FNV-1a hash of the model's epoch and coefficients
+    uint64_t model_hash;
+    double dyear0, dyear1, height0, height1, lat0, lat1;
+    uint64_t num_epochs, num_heights, num_lats, num_lons;
+    uint64_t data_offset;
+    // Size of the whole table [bytes]
+    uint64_t size;
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void *bytes, const size_t size) {
+    const unsigned char *p = bytes;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ p[i]) * 0x100000001b3u;
+    }
+    return hash;
+}
+
+static uint64_t model_hash(const struct geomag_model *model) {
+    const uint64_t hash = hash_bytes(0xcbf29ce484222325u, &model->epoch, sizeof(model->epoch));
+    return hash_bytes(hash, model->coeffs, sizeof(model->coeffs));
+}
+
+// Multiplies sizes, returns 0 on overflow
+static size_t mul_size(const size_t a, const size_t b) {
+    return (a != 0 && b > SIZE_MAX / a) ? 0 : a * b;
+}
+
+// Fills the header a table of a spec has, returns -1 if the spec is invalid.
+// Leaves the model hash 0 when `model` is NULL, for sizing only.
+static int fill_header(
+    const struct geomag_model *model, const struct geomag_table_spec *spec, struct table_header *header
+) {
+    if (spec->num_epochs == 0 || spec->num_heights == 0 || spec->num_lats == 0 || spec->num_lons == 0
+        || (spec->num_epochs > 1 && !(spec->dyear1 != spec->dyear0))
+        || (spec->num_heights > 1 && !(spec->height1 != spec->height0))
+        || (spec->num_lats > 1 && !(spec->lat1 != spec->lat0))) {
+        return -1;
+    }
+    const size_t num_axes = spec->num_epochs + spec->num_heights + spec->num_lats + spec->num_lons;
+    // The field starts on a cache line
+    const size_t data_offset = (sizeof(struct table_header) + num_axes * sizeof(real) + 63) / 64 * 64;
+    const size_t points = mul_size(
+        mul_size(mul_size(spec->num_epochs, spec->num_heights), spec->num_lats), spec->num_lons
+    );
+    const size_t data_size = mul_size(points, sizeof(real[3]));
+    if (num_axes < spec->num_lons || data_size == 0 || data_size > SIZE_MAX - data_offset) {
+        return -1;
+    }
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TABLE_MAGIC, sizeof(TABLE_MAGIC));
+    header->version = GEOMAG_TABLE_VERSION;
+    header->byte_order = 1;
+    header->real_size = sizeof(real);
+    header->model_hash = (model != NULL) ? model_hash(model) : 0;
+    header->dyear0 = (double) spec->dyear0;
+    header->dyear1 = (double) spec->dyear1;
+    header->height0 = (double) spec->height0;
+    header->height1 = (double) spec->height1;
+    header->lat0 = (double) spec->lat0;
+    header->lat1 = (double) spec->lat1;
+    header->num_epochs = spec->num_epochs;
+    header->num_heights = spec->num_heights;
+    header->num_lats = spec->num_lats;
+    header->num_lons = spec->num_lons;
+    header->data_offset = data_offset;
+    header->size = data_offset + data_size;
+    return 0;
+}
+
+size_t geomag_table_size(const struct geomag_table_spec *spec) {
+    struct table_header header;
+    return (fill_header(NULL, spec, &header) == 0) ? (size_t) header.size : 0;
+}
+
+// Fills an evenly spaced axis
+static void fill_axis(real *axis, const real first, const real last, const size_t count) {
+    const real step = (count > 1) ? (last - first) / (real) (count - 1) : 0;
+    for (size_t i = 0; i < count; ++i) {
+        axis[i] = first + step * (real) i;
+    }
+}
+
+int geomag_table_build(
+    const struct geomag_model *model, const struct geomag_table_spec *spec, void *bytes, const size_t size
+) {
+    struct table_header header;
+    if (fill_header(model, spec, &header) != 0 || size < header.size) {
+        return -1;
+    }
+    // A stale header must not describe the table while it is rebuilt
+    memset(bytes, 0, sizeof(header));
+    real *epochs = (real *) ((unsigned char *) bytes + sizeof(header));
+    real *heights = epochs + spec->num_epochs;
+    real *lats = heights + spec->num_heights;
+    real *lons = lats + spec->num_lats;
+    fill_axis(epochs, spec->dyear0, spec->dyear1, spec->num_epochs);
+    fill_axis(heights, spec->height0, spec->height1, spec->num_heights);
+    fill_axis(lats, spec->lat0, spec->lat1, spec->num_lats);
+    for (size_t i = 0; i < spec->num_lons; ++i) {
+        lons[i] = -PI + 2 * PI * (real) i / (real) spec->num_lons;
+    }
+    real (*mag)[3] = (real (*)[3]) ((unsigned char *) bytes + header.data_offset);
+    const size_t per_epoch = spec->num_heights * spec->num_lats * spec->num_lons;
+    for (size_t e = 0; e < spec->num_epochs; ++e) {
+        geomag_grid(
+            model, epochs[e], spec->num_heights, heights, spec->num_lats, lats, spec->num_lons, lons,
+            mag + e * per_epoch
+        );
+    }
+    memcpy(bytes, &header, sizeof(header));
+    return 0;
+}
+
+int geomag_table_open(
+    const void *bytes, const size_t size, const struct geomag_model *model, const struct geomag_table_spec *spec,
+    struct geomag_table *table
+) {
+    struct table_header stored, expected;
+    if (size < sizeof(stored)) {
+        return -1;
+    }
+    memcpy(&stored, bytes, sizeof(stored));
+    if (memcmp(stored.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC)) != 0) {
+        return -1;
+    }
+    // Every field is checked by rebuilding the header from its spec
+    struct geomag_table_spec stored_spec;
+    stored_spec.dyear0 = (real) stored.dyear0;
+    stored_spec.dyear1 = (real) stored.dyear1;
+    stored_spec.num_epochs = (size_t) stored.num_epochs;
+    stored_spec.height0 = (real) stored.height0;
+    stored_spec.height1 = (real) stored.height1;
+    stored_spec.num_heights = (size_t) stored.num_heights;
+    stored_spec.lat0 = (real) stored.lat0;
+    stored_spec.lat1 = (real) stored.lat1;
+    stored_spec.num_lats = (size_t) stored.num_lats;
+    stored_spec.num_lons = (size_t) stored.num_lons;
+    if (spec == NULL) {
+        spec = &stored_spec;
+    }
+    if (fill_header(model, spec, &expected) != 0 || memcmp(&stored, &expected, sizeof(stored)) != 0
+        || size < stored.size) {
+        return -1;
+    }
+    table->spec = *spec;
+    table->mag_itrf = (const real (*)[3]) ((const unsigned char *) bytes + stored.data_offset);
+    return 0;
+}
+
+// Finds the cell of a coordinate on an evenly spaced axis, clamped to it.
+//
+// Returns the index of the cell's first node, and the fraction of the way
+// to the next node, which is `step` indices on.
+static size_t locate(
+    const real x, const real first, const real last, const size_t count, real *frac, size_t *step
+) {
+    *frac = 0;
+    *step = 0;
+    if (count < 2) {
+        return 0;
+    }
+    const real u = (x - first) / (last - first) * (real) (count - 1);
+    *step = 1;
+    // Also catches NaN
+    if (!(u > 0)) {
+        return 0;
+    }
+    if (u >= (real) (count - 1)) {
+        *frac = 1;
+        return count - 2;
+    }
+    size_t i = (size_t) u;
+    i = (i > count - 2) ? count - 2 : i;
+    *frac = u - (real) i;
+    return i;
+}
+
+void geomag_table_eval(
+    const struct geomag_table *table, const real dyear, const real (*lla)[3], real (*mag_itrf)[3]
+) {
+    const struct geomag_table_spec *spec = &table->spec;
+    real frac[4];
+    size_t index[4][2];
+    size_t step;
+    index[0][0] = locate(dyear, spec->dyear0, spec->dyear1, spec->num_epochs, &frac[0], &step);
+    index[0][1] = index[0][0] + step;
+    index[1][0] = locate((*lla)[2], spec->height0, spec->height1, spec->num_heights, &frac[1], &step);
+    index[1][1] = index[1][0] + step;
+    index[2][0] = locate((*lla)[0], spec->lat0, spec->lat1, spec->num_lats, &frac[2], &step);
+    index[2][1] = index[2][0] + step;
+    // Longitude wraps around the circle
+    const real n = (real) spec->num_lons;
+    real u = ((*lla)[1] + PI) / (2 * PI) * n;
+    u -= n * REAL_FLOOR(u / n);
+    size_t i = (u > 0) ? (size_t) u : 0;
+    i = (i >= spec->num_lons) ? spec->num_lons - 1 : i;
+    frac[3] = u - (real) i;
+    index[3][0] = i;
+    index[3][1] = (i + 1) % spec->num_lons;
+
+    real sum[3] = {0, 0, 0};
+    for (int c = 0; c < 16; ++c) {
+        size_t offset = 0;
+        real weight = 1;
+        const size_t dims[4] = {spec->num_epochs, spec->num_heights, spec->num_lats, spec->num_lons};
+        for (int d = 0; d < 4; ++d) {
+            const int upper = (c >> (3 - d)) & 1;
+            offset = offset * dims[d] + index[d][upper];
+            weight *= upper ? frac[d] : 1 - frac[d];
+        }
+        for (int k = 0; k < 3; ++k) {
+            sum[k] += weight * table->mag_itrf[offset][k];
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        (*mag_itrf)[k] = sum[k];
+    }
+}
+
+void geomag_table_batch(
+    const struct geomag_table *table, const size_t count, const real *dyear, const real (*lla)[3],
+    real (*mag_itrf)[3]
+) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_table_eval(table, dyear[i], &lla[i], &mag_itrf[i]);
+    }
+}
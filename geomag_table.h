@@ -0,0 +1,143 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_TABLE_H
+#define GEOMAG_TABLE_H
+
+#include "geomag.h"
+
+// Version of the table layout, bumped on any change to it
+#define GEOMAG_TABLE_VERSION 1
+
+// Regular grid of a field table.
+//
+// Epochs, heights and latitudes are evenly spaced from the first to the
+// last value inclusive. Longitudes cover the full circle from -pi without
+// repeating the seam.
+struct geomag_table_spec {
+    // Decimal years
+    real dyear0, dyear1;
+    size_t num_epochs;
+    // Heights above the WGS 84 ellipsoid [m]
+    real height0, height1;
+    size_t num_heights;
+    // WGS 84 geodetic latitudes [rad]
+    real lat0, lat1;
+    size_t num_lats;
+    size_t num_lons;
+};
+
+// Read-only view of a field table in memory
+struct geomag_table {
+    struct geomag_table_spec spec;
+    // Field in ITRF frame [T], ordered by epoch, height, latitude, then
+    // longitude
+    const real (*mag_itrf)[3];
+};
+
+// Returns the bytes needed to hold a table.
+//
+// A table is a self-describing block of memory, a header keyed by the
+// layout version, the model and the grid spec, then the axes and the
+// field. It holds no pointers, so it can be written to a file or a shared
+// memory segment that other processes map read-only and open in place.
+//
+// Args:
+//     spec: Grid of the table
+//
+// Returns:
+//     Size of the table [bytes], 0 if the spec is invalid or too large
+size_t geomag_table_size(const struct geomag_table_spec *spec);
+
+// Builds a table of a model into caller provided memory.
+//
+// Each epoch is synthesized with `geomag_grid`, split across threads when
+// compiled with OpenMP. The header is written last, so a table that is
+// not completely built never opens.
+//
+// Args:
+//     model: Magnetic field model
+//     spec: Grid of the table
+//     bytes: Storage for the table, aligned for `real`
+//     size: Bytes available, at least `geomag_table_size(spec)`
+//
+// Returns:
+//     0 on success, -1 if the spec is invalid or `size` too small
+int geomag_table_build(
+    const struct geomag_model *model, const struct geomag_table_spec *spec, void *bytes, size_t size
+);
+
+// Opens a table in memory, checking that it is the one wanted.
+//
+// Fails on a table of another layout version, byte order or `real` type,
+// of a different model or spec, or one that is truncated, so a stale
+// table is rebuilt instead of used.
+//
+// Args:
+//     bytes: The table, aligned for `real`, for example mapped from a file
+//     size: Bytes available
+//     model: Model the table must be of
+//     spec: Grid the table must have, or NULL to accept any
+//
+// Returns:
+//     table: View into `bytes`, valid as long as they are
+//     0 on success, -1 if the table does not match
+int geomag_table_open(
+    const void *bytes, size_t size, const struct geomag_model *model, const struct geomag_table_spec *spec,
+    struct geomag_table *table
+);
+
+// Interpolates the field from a table.
+//
+// Interpolates linearly in epoch, height, latitude and longitude.
+// Positions and epochs outside the table are clamped to its edge.
+//
+// Args:
+//     table: Open table
+//     dyear: Decimal year
+//     lla: WGS 84 geodetic latitude [rad], longitude [rad] and height above
+//         the ellipsoid [m]
+//
+// Returns:
+//     mag_itrf: Magnetic field vector in ITRF frame [T]
+void geomag_table_eval(const struct geomag_table *table, real dyear, const real (*lla)[3], real (*mag_itrf)[3]);
+
+// Interpolates the field from a table for a batch of positions.
+//
+// Positions are split across threads when compiled with OpenMP.
+//
+// Args:
+//     table: Open table
+//     count: Number of positions
+//     dyear: Decimal year of each position
+//     lla: WGS 84 geodetic latitude [rad], longitude [rad] and height
+//
+// Returns:
+//     mag_itrf: Magnetic field vectors in ITRF frame [T]
+void geomag_table_batch(
+    const struct geomag_table *table, size_t count, const real *dyear, const real (*lla)[3], real (*mag_itrf)[3]
+);
+
+#endif // GEOMAG_TABLE_H
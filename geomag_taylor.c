@@ -0,0 +1,148 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_taylor.h"
+#include "math.h"
+
+// Truncation error of an order 1 or 2 Taylor expansion, relative to the
+// field, is estimated as TAYLOR_ERR[order] * (d / r)^(order + 1). The
+// constants are the remainder terms of a dipole, 3 * 4 / 2! and 3 * 4 * 5 / 3!,
+// which dominates the derivatives everywhere above the surface.
+static const real TAYLOR_ERR[3] = {0, 6, 10};
+
+void geomag_trajectory_init(
+    struct geomag_trajectory *traj, const struct geomag_model *model, const int order, const real tol
+) {
+    traj->model = model;
+    traj->order = (order < 2) ? 1 : 2;
+    traj->tol = tol;
+    traj->valid = 0;
+    traj->radius = 0;
+    traj->num_exact = 0;
+    traj->num_predicted = 0;
+}
+
+// Distance from an expansion point within which predictions meet `tol`
+static real reuse_radius(const real *pos, const real *mag, const int order, const real tol) {
+    const real r = REAL_SQRT(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+    const real mag_norm = REAL_SQRT(mag[0] * mag[0] + mag[1] * mag[1] + mag[2] * mag[2]);
+    if (!(mag_norm > 0)) {
+        return 0;
+    }
+    const real rel_tol = tol / (TAYLOR_ERR[order] * mag_norm);
+    return r * REAL_POW(rel_tol, ((real) 1) / (order + 1));
+}
+
+// Taylor prediction at offset `d` and `dt` years from the expansion point
+static void taylor_predict(
+    const struct geomag_jet *jet, const int order, const real d[3], const real dt, real (*mag_itrf)[3]
+) {
+    // The field is linear in time, so secular variation is applied exactly
+    for (int i = 0; i < 3; ++i) {
+        real value = jet->mag[i] + dt * jet->mag_rate[i];
+        for (int j = 0; j < 3; ++j) {
+            real step = jet->grad[i][j];
+            if (order == 2) {
+                for (int k = 0; k < 3; ++k) {
+                    step += REAL_HALF * jet->hess[i][j][k] * d[k];
+                }
+            }
+            value += step * d[j];
+        }
+        (*mag_itrf)[i] = value;
+    }
+}
+
+int geomag_trajectory_eval(
+    struct geomag_trajectory *traj, const real dyear, const real (*pos_itrf)[3], real (*mag_itrf)[3]
+) {
+    real d[3];
+    real dist_sq = 0;
+    for (int i = 0; i < 3; ++i) {
+        d[i] = (*pos_itrf)[i] - traj->pos[i];
+        dist_sq += d[i] * d[i];
+    }
+
+    if (!traj->valid || dist_sq > traj->radius * traj->radius) {
+        geomag_jet(traj->model, dyear, pos_itrf, traj->order, &traj->jet);
+        traj->valid = 1;
+        traj->dyear = dyear;
+        for (int i = 0; i < 3; ++i) {
+            traj->pos[i] = (*pos_itrf)[i];
+            (*mag_itrf)[i] = traj->jet.mag[i];
+        }
+        traj->radius = reuse_radius(traj->pos, traj->jet.mag, traj->order, traj->tol);
+        ++traj->num_exact;
+        return 1;
+    }
+
+    taylor_predict(&traj->jet, traj->order, d, dyear - traj->dyear, mag_itrf);
+    ++traj->num_predicted;
+    return 0;
+}
+
+size_t geomag_cloud(
+    const struct geomag_model *model, const real dyear, const size_t count, const real (*pos_itrf)[3],
+    const int order, const real tol, real (*mag_itrf)[3]
+) {
+    if (count == 0) {
+        return 0;
+    }
+    const int taylor_order = (order < 2) ? 1 : 2;
+    real centroid[3] = {0, 0, 0};
+    for (size_t p = 0; p < count; ++p) {
+        for (int i = 0; i < 3; ++i) {
+            centroid[i] += pos_itrf[p][i];
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        centroid[i] /= (real) count;
+    }
+
+    struct geomag_jet jet;
+    geomag_jet(model, dyear, (const real (*)[3]) &centroid, taylor_order, &jet);
+    const real radius = reuse_radius(centroid, jet.mag, taylor_order, tol);
+    const real radius_sq = radius * radius;
+
+    size_t num_exact = 1;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:num_exact)
+#endif
+    for (size_t p = 0; p < count; ++p) {
+        real d[3];
+        real dist_sq = 0;
+        for (int i = 0; i < 3; ++i) {
+            d[i] = pos_itrf[p][i] - centroid[i];
+            dist_sq += d[i] * d[i];
+        }
+        if (dist_sq > radius_sq) {
+            geomag_eval(model, dyear, &pos_itrf[p], &mag_itrf[p]);
+            ++num_exact;
+        } else {
+            taylor_predict(&jet, taylor_order, d, 0, &mag_itrf[p]);
+        }
+    }
+    return num_exact;
+}
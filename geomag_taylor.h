@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_TAYLOR_H
+#define GEOMAG_TAYLOR_H
+
+#include "geomag.h"
+
+// Stateful evaluator for closely spaced samples along a trajectory.
+//
+// Keeps the last exact evaluation as an anchor and returns Taylor
+// predictions around it. A fresh evaluation runs only once a sample is
+// further from the anchor than the reuse radius, which is picked so the
+// estimated truncation error stays under the tolerance.
+struct geomag_trajectory {
+    const struct geomag_model *model;
+    // Taylor order of predictions, 1 or 2
+    int order;
+    // Tolerance on the truncation error of predictions [T]
+    real tol;
+    // Whether an anchor has been evaluated yet
+    int valid;
+    real dyear;
+    real pos[3];
+    struct geomag_jet jet;
+    // Samples within this distance of the anchor are predicted [m]
+    real radius;
+    // Number of exact evaluations and Taylor predictions
+    size_t num_exact;
+    size_t num_predicted;
+};
+
+// Resets a trajectory evaluator.
+//
+// Args:
+//     model: Magnetic field model
+//     order: Taylor order of predictions, 1 or 2
+//     tol: Tolerance on the truncation error of predictions [T]
+//
+// Returns:
+//     traj: Evaluator with no anchor
+void geomag_trajectory_init(
+    struct geomag_trajectory *traj, const struct geomag_model *model, int order, real tol
+);
+
+// Returns magnetic field vector in ITRF at the next trajectory sample.
+//
+// Args:
+//     traj: Evaluator
+//     dyear: Decimal year
+//     pos_itrf: ECEF position vector in ITRF frame [m]
+//
+// Returns:
+//     mag_itrf: Magnetic field vector in ITRF frame [T]
+//     1 if the sample was evaluated exactly and is the new anchor, else 0
+int geomag_trajectory_eval(
+    struct geomag_trajectory *traj, real dyear, const real (*pos_itrf)[3], real (*mag_itrf)[3]
+);
+
+// Returns magnetic field vectors for a cloud of clustered positions.
+//
+// Meant for particle filters, where particles are scattered close to a
+// mean state. The field and its derivatives are evaluated exactly at the
+// centroid once, and particles within the reuse radius for `tol` get a
+// Taylor prediction from it. Outliers beyond the radius are evaluated
+// exactly. Particles are split across threads when compiled with OpenMP.
+//
+// Args:
+//     model: Magnetic field model
+//     dyear: Decimal year
+//     count: Number of positions
+//     pos_itrf: ECEF position vectors in ITRF frame [m]
+//     order: Taylor order of predictions, 1 or 2
+//     tol: Tolerance on the truncation error of predictions [T]
+//
+// Returns:
+//     mag_itrf: Magnetic field vectors in ITRF frame [T]
+//     Number of exact evaluations, including the centroid
+size_t geomag_cloud(
+    const struct geomag_model *model, real dyear, size_t count, const real (*pos_itrf)[3],
+    int order, real tol, real (*mag_itrf)[3]
+);
+
+#endif // GEOMAG_TAYLOR_H
@@ -0,0 +1,378 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geomag_trace.h"
+#include "math.h"
+
+// Dormand-Prince RK45 tableau, the field is autonomous so the nodes aren't needed
+static const real DP_A[7][6] = {
+    {0, 0, 0, 0, 0, 0},
+    {1.0 / 5, 0, 0, 0, 0, 0},
+    {3.0 / 40, 9.0 / 40, 0, 0, 0, 0},
+    {44.0 / 45, -56.0 / 15, 32.0 / 9, 0, 0, 0},
+    {19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729, 0, 0},
+    {9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656, 0},
+    {35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84},
+};
+// Fifth order weights are the last row of DP_A, these are fifth minus fourth
+static const real DP_E[7] = {
+    71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40
+};
+
+// Secant iterations to locate a stopping point
+#define TRACE_EVENT_ITERS 30
+
+// Fraction of the radius of curvature taken as the first step
+static const real TRACE_CURVATURE_STEP = 0.05;
+
+// Integrated state, the position and the mirror integral
+#define TRACE_DIM 4
+
+// Events watched at each step, see `events`
+enum trace_event { EVENT_ALTITUDE, EVENT_EQUATOR, EVENT_MIN_B, EVENT_MIRROR, NUM_EVENTS };
+
+// Trace state at one point of the line
+struct trace_point {
+    real y[TRACE_DIM];
+    // Derivative of `y` along the line
+    real dy[TRACE_DIM];
+    real mag_norm;
+    // Event functions, a sign change between points means a crossing
+    real g[NUM_EVENTS];
+};
+
+void geomag_trace_opts_default(struct geomag_trace_opts *opts, const real dyear) {
+    opts->dyear = dyear;
+    opts->direction = 1;
+    opts->r_stop = 6371200.0;
+    opts->stop_at_equator = 0;
+    opts->stop_at_min_b = 0;
+    opts->b_mirror = 0;
+    opts->max_length = 1e9;
+    opts->tol = 1;
+    opts->max_step = 1000000;
+    opts->max_steps = 100000;
+}
+
+static real norm(const real v[3]) {
+    return REAL_SQRT(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+// Derivative of the state, returns 0 at a null field
+static int derivative(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, const real y[TRACE_DIM],
+    real dy[TRACE_DIM], real *mag_norm
+) {
+    real mag[3];
+    geomag_eval(model, opts->dyear, (const real (*)[3]) y, &mag);
+    *mag_norm = norm(mag);
+    if (!(*mag_norm > 0)) {
+        return 0;
+    }
+    for (int i = 0; i < 3; ++i) {
+        dy[i] = opts->direction * mag[i] / *mag_norm;
+    }
+    if (opts->b_mirror > 0) {
+        const real ratio = 1 - *mag_norm / opts->b_mirror;
+        dy[3] = (ratio > 0) ? REAL_SQRT(ratio) : 0;
+    } else {
+        dy[3] = 0;
+    }
+    return 1;
+}
+
+// Fills in the event functions at a point whose derivative is known
+static void events(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, struct trace_point *p
+) {
+    const real r = norm(p->y);
+    p->g[EVENT_ALTITUDE] = r - opts->r_stop;
+    // Radial component of the tangent, zero at the magnetic equator of the line
+    p->g[EVENT_EQUATOR] = (p->y[0] * p->dy[0] + p->y[1] * p->dy[1] + p->y[2] * p->dy[2]) / r;
+    p->g[EVENT_MIRROR] = p->mag_norm - opts->b_mirror;
+    p->g[EVENT_MIN_B] = 0;
+    if (opts->stop_at_min_b || opts->b_mirror > 0) {
+        // d|B|/ds = b . grad(B) . t, from the analytic gradient
+        struct geomag_jet jet;
+        geomag_jet(model, opts->dyear, (const real (*)[3]) p->y, 1, &jet);
+        real rate = 0;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                rate += p->dy[i] * jet.grad[i][j] * p->dy[j];
+            }
+        }
+        p->g[EVENT_MIN_B] = opts->direction * rate;
+    }
+}
+
+// Whether an event is crossed going from `a` to `b`
+static int crossed(const struct geomag_trace_opts *opts, const int e, const real g_a, const real g_b) {
+    switch (e) {
+    case EVENT_ALTITUDE:
+        return opts->r_stop > 0 && g_a > 0 && g_b <= 0;
+    case EVENT_EQUATOR:
+        return opts->stop_at_equator && g_a != 0 && g_a * g_b <= 0;
+    case EVENT_MIN_B:
+        return (opts->stop_at_min_b || opts->b_mirror > 0) && g_a < 0 && g_b >= 0;
+    default:
+        return opts->b_mirror > 0 && g_a < 0 && g_b >= 0;
+    }
+}
+
+// Takes one RK45 step of size h from `p`, returns the error estimate, or -1
+// at a null field. The event functions of `out` are not filled in.
+static real rk45_step(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, const struct trace_point *p,
+    const real h, struct trace_point *out
+) {
+    real k[7][TRACE_DIM];
+    for (int i = 0; i < TRACE_DIM; ++i) {
+        k[0][i] = p->dy[i];
+    }
+    for (int stage = 1; stage < 7; ++stage) {
+        real stage_y[TRACE_DIM];
+        for (int i = 0; i < TRACE_DIM; ++i) {
+            real sum = 0;
+            for (int j = 0; j < stage; ++j) {
+                sum += DP_A[stage][j] * k[j][i];
+            }
+            stage_y[i] = p->y[i] + h * sum;
+        }
+        if (!derivative(model, opts, stage_y, k[stage], &out->mag_norm)) {
+            return -1;
+        }
+        if (stage == 6) {
+            for (int i = 0; i < TRACE_DIM; ++i) {
+                out->y[i] = stage_y[i];
+                out->dy[i] = k[6][i];
+            }
+        }
+    }
+    real err = 0;
+    for (int i = 0; i < TRACE_DIM; ++i) {
+        real sum = 0;
+        for (int j = 0; j < 7; ++j) {
+            sum += DP_E[j] * k[j][i];
+        }
+        const real comp_err = REAL_FABS(h * sum);
+        err = (comp_err > err) ? comp_err : err;
+    }
+    return err;
+}
+
+// Locates an event crossed on the step of size h from `p` by regula falsi
+// with the Illinois modification, returns the step size to it
+static real locate(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, const struct trace_point *p,
+    const int e, const real h, const struct trace_point *end, struct trace_point *located
+) {
+    real lo = 0, hi = h;
+    real g_lo = p->g[e], g_hi = end->g[e];
+    real located_h = h;
+    int side = 0;
+    *located = *end;
+    for (int iter = 0; iter < TRACE_EVENT_ITERS && hi - lo > 1e-6 * opts->tol; ++iter) {
+        const real trial = (lo * g_hi - hi * g_lo) / (g_hi - g_lo);
+        struct trace_point trial_point;
+        if (rk45_step(model, opts, p, trial, &trial_point) < 0) {
+            break;
+        }
+        events(model, opts, &trial_point);
+        *located = trial_point;
+        located_h = trial;
+        if (trial_point.g[e] == 0) {
+            break;
+        }
+        if ((trial_point.g[e] > 0) == (g_lo > 0)) {
+            lo = trial;
+            g_lo = trial_point.g[e];
+            g_hi = (side == -1) ? REAL_HALF * g_hi : g_hi;
+            side = -1;
+        } else {
+            hi = trial;
+            g_hi = trial_point.g[e];
+            g_lo = (side == 1) ? REAL_HALF * g_lo : g_lo;
+            side = 1;
+        }
+    }
+    return located_h;
+}
+
+// First step, a fraction of the radius of curvature of the line
+static real initial_step(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, const real pos[3]
+) {
+    struct geomag_jet jet;
+    geomag_jet(model, opts->dyear, (const real (*)[3]) pos, 1, &jet);
+    const real mag_norm = norm(jet.mag);
+    if (!(mag_norm > 0)) {
+        return opts->max_step;
+    }
+    // Curvature is the part of dB/ds normal to B, over |B|
+    real b[3], db[3];
+    for (int i = 0; i < 3; ++i) {
+        b[i] = jet.mag[i] / mag_norm;
+    }
+    real along = 0;
+    for (int i = 0; i < 3; ++i) {
+        db[i] = jet.grad[i][0] * b[0] + jet.grad[i][1] * b[1] + jet.grad[i][2] * b[2];
+        along += db[i] * b[i];
+    }
+    for (int i = 0; i < 3; ++i) {
+        db[i] -= along * b[i];
+    }
+    const real curvature = norm(db) / mag_norm;
+    const real h = (curvature > 0) ? TRACE_CURVATURE_STEP / curvature : opts->max_step;
+    return (h < opts->max_step) ? h : opts->max_step;
+}
+
+static void add_point(
+    const struct trace_point *p, real (*points)[3], const size_t capacity, struct geomag_trace_result *result
+) {
+    if (points != NULL && result->num_points < capacity) {
+        for (int i = 0; i < 3; ++i) {
+            points[result->num_points][i] = p->y[i];
+        }
+        ++result->num_points;
+    }
+}
+
+static void record_min_b(const struct trace_point *p, const real length, struct geomag_trace_result *result) {
+    if (p->mag_norm < result->b_min) {
+        result->b_min = p->mag_norm;
+        result->b_min_length = length;
+        for (int i = 0; i < 3; ++i) {
+            result->b_min_pos[i] = p->y[i];
+        }
+    }
+}
+
+void geomag_trace(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, const real (*pos_itrf)[3],
+    real (*points)[3], const size_t capacity, struct geomag_trace_result *result
+) {
+    struct trace_point p, next;
+    for (int i = 0; i < 3; ++i) {
+        p.y[i] = (*pos_itrf)[i];
+    }
+    p.y[3] = 0;
+    result->length = 0;
+    result->num_steps = 0;
+    result->num_points = 0;
+    result->stop = GEOMAG_TRACE_FAILED;
+    result->b_min = INFINITY;
+    result->b_min_length = 0;
+    for (int i = 0; i < 3; ++i) {
+        result->b_min_pos[i] = 0;
+    }
+    add_point(&p, points, capacity, result);
+
+    if (derivative(model, opts, p.y, p.dy, &p.mag_norm)) {
+        events(model, opts, &p);
+        result->b_min = p.mag_norm;
+        for (int i = 0; i < 3; ++i) {
+            result->b_min_pos[i] = p.y[i];
+        }
+        real h = initial_step(model, opts, p.y);
+        while (result->num_steps < opts->max_steps) {
+            const real remaining = opts->max_length - result->length;
+            const int last = (h >= remaining);
+            const real step = last ? remaining : h;
+            const real err = rk45_step(model, opts, &p, step, &next);
+            if (err < 0) {
+                break;
+            }
+            ++result->num_steps;
+            // Standard step size control, with growth and shrink bounds
+            const real scale = (err > 0) ? 0.9 * REAL_POW(opts->tol / err, 0.2) : 5;
+            h = step * ((scale < 0.2) ? 0.2 : (scale > 5) ? 5 : scale);
+            h = (h < opts->max_step) ? h : opts->max_step;
+            if (err > opts->tol) {
+                continue;
+            }
+            events(model, opts, &next);
+
+            // Find the earliest stopping event on the step
+            int stop_event = -1;
+            real stop_h = step;
+            struct trace_point stop_point;
+            for (int e = 0; e < NUM_EVENTS; ++e) {
+                if (!crossed(opts, e, p.g[e], next.g[e])) {
+                    continue;
+                }
+                struct trace_point located;
+                const real located_h = locate(model, opts, &p, e, step, &next, &located);
+                if (e == EVENT_MIN_B && !opts->stop_at_min_b) {
+                    // Just a minimum to record, if reached before any stop
+                    if (stop_event < 0 || located_h <= stop_h) {
+                        record_min_b(&located, result->length + located_h, result);
+                    }
+                    continue;
+                }
+                if (stop_event < 0 || located_h < stop_h) {
+                    stop_event = e;
+                    stop_h = located_h;
+                    stop_point = located;
+                }
+            }
+            if (stop_event >= 0) {
+                result->length += stop_h;
+                p = stop_point;
+                record_min_b(&p, result->length, result);
+                add_point(&p, points, capacity, result);
+                result->stop = (stop_event == EVENT_ALTITUDE) ? GEOMAG_TRACE_ALTITUDE
+                    : (stop_event == EVENT_EQUATOR) ? GEOMAG_TRACE_EQUATOR
+                    : (stop_event == EVENT_MIN_B) ? GEOMAG_TRACE_MIN_B
+                    : GEOMAG_TRACE_MIRROR;
+                break;
+            }
+
+            result->length += step;
+            p = next;
+            record_min_b(&p, result->length, result);
+            add_point(&p, points, capacity, result);
+            if (last) {
+                result->stop = GEOMAG_TRACE_LENGTH;
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        result->pos[i] = p.y[i];
+    }
+    result->integral = p.y[3];
+}
+
+void geomag_trace_batch(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, const size_t count,
+    const real (*pos_itrf)[3], struct geomag_trace_result *result
+) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        geomag_trace(model, opts, &pos_itrf[i], NULL, 0, &result[i]);
+    }
+}
@@ -0,0 +1,142 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMAG_TRACE_H
+#define GEOMAG_TRACE_H
+
+#include "geomag.h"
+
+// Why a field line trace stopped
+enum geomag_trace_stop {
+    // Fell below `r_stop`
+    GEOMAG_TRACE_ALTITUDE,
+    // Crossed the magnetic equator of the line, where B is normal to r
+    GEOMAG_TRACE_EQUATOR,
+    // Reached the minimum of |B| along the line
+    GEOMAG_TRACE_MIN_B,
+    // |B| rose back to `b_mirror` past the minimum
+    GEOMAG_TRACE_MIRROR,
+    // Reached `max_length`
+    GEOMAG_TRACE_LENGTH,
+    // Ran out of steps or hit a null field
+    GEOMAG_TRACE_FAILED
+};
+
+// Options of a field line trace
+struct geomag_trace_opts {
+    // Decimal year, the field is frozen at this epoch while tracing
+    real dyear;
+    // 1 to trace along the field, -1 against it
+    int direction;
+    // Stop once the geocentric radius falls below this, 0 to disable [m]
+    real r_stop;
+    // Whether to stop at the magnetic equator of the line
+    int stop_at_equator;
+    // Whether to stop at the minimum of |B| along the line
+    int stop_at_min_b;
+    // Mirror field of a bouncing particle, 0 to disable [T]. If set, the
+    // trace integrates sqrt(1 - |B| / b_mirror) and stops where |B| rises
+    // back to `b_mirror` past the minimum.
+    real b_mirror;
+    // Longest line to trace [m]
+    real max_length;
+    // Tolerance on the position error of each step [m]
+    real tol;
+    // Longest step to take [m]
+    real max_step;
+    // Most steps to take before giving up
+    size_t max_steps;
+};
+
+// Result of a field line trace
+struct geomag_trace_result {
+    // Final ECEF position vector in ITRF frame [m]
+    real pos[3];
+    // Length of the traced line [m]
+    real length;
+    // Integral of sqrt(1 - |B| / b_mirror) along the line, if `b_mirror` [m]
+    real integral;
+    // Smallest |B| along the line [T], where and how far along it was [m],
+    // INFINITY and zeros if the field can't be evaluated at the start
+    real b_min;
+    real b_min_pos[3];
+    real b_min_length;
+    enum geomag_trace_stop stop;
+    size_t num_steps;
+    // Number of points written to the optional polyline
+    size_t num_points;
+};
+
+// Fills in default options, tracing along the field down to the surface.
+//
+// Args:
+//     dyear: Decimal year
+//
+// Returns:
+//     opts: 1 m tolerance, 1000 km steps, 1e9 m length, no other stops
+void geomag_trace_opts_default(struct geomag_trace_opts *opts, real dyear);
+
+// Traces a magnetic field line from a position.
+//
+// Integrates dr/ds = B / |B| with adaptive Dormand-Prince RK45 steps. The
+// first step is sized from the line curvature, using the analytic field
+// gradient, which also locates minima of |B| when those are needed.
+// Stopping points are located on the boundary by regula falsi with the
+// Illinois modification on the last step.
+//
+// Args:
+//     model: Magnetic field model
+//     opts: Trace options
+//     pos_itrf: Starting ECEF position vector in ITRF frame [m]
+//     points: Optional polyline of the accepted steps, starting with
+//         `pos_itrf`, or NULL
+//     capacity: Number of points `points` can hold
+//
+// Returns:
+//     points: Up to `capacity` points along the line
+//     result: End of the line and why it stopped
+void geomag_trace(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, const real (*pos_itrf)[3],
+    real (*points)[3], size_t capacity, struct geomag_trace_result *result
+);
+
+// Traces a batch of magnetic field lines.
+//
+// Lines are split across threads when compiled with OpenMP.
+//
+// Args:
+//     model: Magnetic field model
+//     opts: Trace options, shared by every line
+//     count: Number of lines
+//     pos_itrf: Starting ECEF position vectors in ITRF frame [m]
+//
+// Returns:
+//     result: End of each line and why it stopped
+void geomag_trace_batch(
+    const struct geomag_model *model, const struct geomag_trace_opts *opts, size_t count,
+    const real (*pos_itrf)[3], struct geomag_trace_result *result
+);
+
+#endif // GEOMAG_TRACE_H
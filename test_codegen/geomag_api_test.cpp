@@ -0,0 +1,393 @@
+// geomag_api_test.cpp Hand-written tests for the API beyond `geomag`
+
+#include "catch.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+extern "C" {
+    #include "../geomag.h"
+}
+
+static std::string read_file(const char *name) {
+    std::ifstream file(name);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static const double TEST_POS[4][3] = {
+    {1111164.8708100126, 0.0, 6259542.961028692},
+    {-3189068.4999999986, 5523628.670817468, 0.0},
+    {-555582.4354050067, -962297.0059143245, -6259542.961028692},
+    {1128529.6885767058, 0.0, 6358023.736329913},
+};
+
+TEST_CASE( "geomag basis matches geomag", "[basis]" ) {
+    const double in[3] = {-3189068.4999999986, 5523628.670817468, 0.0};
+    double out[3];
+    double truth[3];
+    struct geomag_basis basis;
+    geomag_basis(&in, &basis);
+    geomag_basis_field(&WMM2020, 2022.5, &basis, &out);
+    geomag(2022.5, &in, &truth);
+    CHECK( out[0]*1E9 == Approx(truth[0]*1E9).margin(1e-6) );
+    CHECK( out[1]*1E9 == Approx(truth[1]*1E9).margin(1e-6) );
+    CHECK( out[2]*1E9 == Approx(truth[2]*1E9).margin(1e-6) );
+}
+
+TEST_CASE( "geomag basis rotation matches rotated position", "[basis]" ) {
+    const double in[3] = {1111164.8708100126, 0.0, 6259542.961028692};
+    struct geomag_basis basis;
+    geomag_basis(&in, &basis);
+    for (int i = 1; i <= 8; ++i) {
+        const double dlon = 0.8 * i;
+        const double rot_in[3] = {std::cos(dlon) * in[0] - std::sin(dlon) * in[1],
+                                  std::sin(dlon) * in[0] + std::cos(dlon) * in[1], in[2]};
+        double out[3];
+        double truth[3];
+        struct geomag_basis rotated;
+        geomag_basis_rotate(&basis, dlon, &rotated);
+        geomag_basis_field(&WMM2020, 2020.0, &rotated, &out);
+        geomag(2020.0, &rot_in, &truth);
+        CHECK( out[0]*1E9 == Approx(truth[0]*1E9).margin(1e-6) );
+        CHECK( out[1]*1E9 == Approx(truth[1]*1E9).margin(1e-6) );
+        CHECK( out[2]*1E9 == Approx(truth[2]*1E9).margin(1e-6) );
+    }
+}
+
+TEST_CASE( "geomag batch with per-point epoch matches geomag", "[batch]" ) {
+    const double dyear[4] = {2020.0, 2021.25, 2022.5, 2024.75};
+    double out[4][3];
+    geomag_batch(&WMM2020, 4, dyear, TEST_POS, out);
+    for (int i = 0; i < 4; ++i) {
+        double truth[3];
+        geomag(dyear[i], &TEST_POS[i], &truth);
+        CHECK( out[i][0] == truth[0] );
+        CHECK( out[i][1] == truth[1] );
+        CHECK( out[i][2] == truth[2] );
+    }
+}
+
+TEST_CASE( "geomag model parsed from COF matches built-in model", "[model]" ) {
+    struct geomag_model model;
+    REQUIRE( geomag_model_parse_cof(read_file("WMM2020.COF").c_str(), &model) == 0 );
+    CHECK( model.epoch == 2020.0 );
+    for (int i = 0; i < WMM_TOT_COEFFS; ++i) {
+        CHECK( model.coeffs[i].main_field_c == Approx(WMM2020.coeffs[i].main_field_c).margin(1e-12) );
+        CHECK( model.coeffs[i].main_field_s == Approx(WMM2020.coeffs[i].main_field_s).margin(1e-12) );
+        CHECK( model.coeffs[i].sec_var_c == Approx(WMM2020.coeffs[i].sec_var_c).margin(1e-12) );
+        CHECK( model.coeffs[i].sec_var_s == Approx(WMM2020.coeffs[i].sec_var_s).margin(1e-12) );
+    }
+    CHECK( geomag_model_parse_cof("2020.0 WMM-2020\n  1  0  -29404.5  0.0  6.7\n", &model) == -1 );
+}
+
+TEST_CASE( "geomag model parse rejects repeated or missing COF rows", "[model]" ) {
+    const std::string text = read_file("WMM2020.COF");
+    const std::string last_row = " 12 12";
+    const size_t last = text.find(last_row);
+    REQUIRE( last != std::string::npos );
+    const size_t last_end = text.find('\n', last) + 1;
+    const size_t first = text.find('\n') + 1;
+    const std::string first_row = text.substr(first, text.find('\n', first) + 1 - first);
+    struct geomag_model model;
+
+    // (12, 12) replaced by a copy of (1, 0)
+    const std::string repeated = text.substr(0, last) + first_row + text.substr(last_end);
+    CHECK( geomag_model_parse_cof(repeated.c_str(), &model) == -1 );
+    // (12, 12) dropped
+    const std::string missing = text.substr(0, last) + text.substr(last_end);
+    CHECK( geomag_model_parse_cof(missing.c_str(), &model) == -1 );
+    // (12, 12) listed twice
+    const std::string twice = text.substr(0, last_end) + text.substr(last, last_end - last) + text.substr(last_end);
+    CHECK( geomag_model_parse_cof(twice.c_str(), &model) == -1 );
+}
+
+TEST_CASE( "geomag basis batch contracts with several models", "[model]" ) {
+    static struct geomag_model models[3];
+    REQUIRE( geomag_model_parse_cof(read_file("WMM2015.COF").c_str(), &models[0]) == 0 );
+    REQUIRE( geomag_model_parse_cof(read_file("WMM2015v2.COF").c_str(), &models[1]) == 0 );
+    REQUIRE( geomag_model_parse_cof(read_file("WMM2020.COF").c_str(), &models[2]) == 0 );
+    const double dyear[4] = {2017.0, 2018.5, 2019.0, 2019.75};
+    static struct geomag_basis basis[4];
+    geomag_basis_batch(4, TEST_POS, basis);
+    for (int k = 0; k < 3; ++k) {
+        double out[4][3];
+        geomag_basis_field_batch(&models[k], 4, dyear, basis, out);
+        for (int i = 0; i < 4; ++i) {
+            double truth[3];
+            geomag_eval(&models[k], dyear[i], &TEST_POS[i], &truth);
+            CHECK( out[i][0]*1E9 == Approx(truth[0]*1E9).margin(1e-6) );
+            CHECK( out[i][1]*1E9 == Approx(truth[1]*1E9).margin(1e-6) );
+            CHECK( out[i][2]*1E9 == Approx(truth[2]*1E9).margin(1e-6) );
+        }
+    }
+}
+
+TEST_CASE( "geomag design product matches geomag for an ensemble", "[design]" ) {
+    const int K = 3;
+    static struct geomag_model perturbed;
+    perturbed = WMM2020;
+    perturbed.coeffs[1].main_field_c += 100.0;
+    perturbed.coeffs[14].main_field_s -= 20.0;
+    const struct geomag_model *models[K] = {&WMM2020, &perturbed, &WMM2020};
+    const double dyear[K] = {2022.5, 2022.5, 2024.0};
+
+    static double design[3 * 4][GEOMAG_DESIGN_COLS];
+    static double coeffs[GEOMAG_DESIGN_COLS * K];
+    double mag[3 * 4 * K];
+    geomag_design_batch(4, TEST_POS, design);
+    for (int j = 0; j < K; ++j) {
+        geomag_model_coeffs(models[j], dyear[j], &coeffs[j], K);
+    }
+    geomag_design_product(3 * 4, K, design, coeffs, mag);
+
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < K; ++j) {
+            double truth[3];
+            geomag_eval(models[j], dyear[j], &TEST_POS[i], &truth);
+            CHECK( mag[(3 * i + 0) * K + j]*1E9 == Approx(truth[0]*1E9).margin(1e-6) );
+            CHECK( mag[(3 * i + 1) * K + j]*1E9 == Approx(truth[1]*1E9).margin(1e-6) );
+            CHECK( mag[(3 * i + 2) * K + j]*1E9 == Approx(truth[2]*1E9).margin(1e-6) );
+        }
+    }
+}
+
+TEST_CASE( "geomag jet matches geomag and finite differences", "[jet]" ) {
+    const double h = 1.0;
+    for (int p = 0; p < 4; ++p) {
+        struct geomag_jet jet;
+        geomag_jet(&WMM2020, 2022.5, &TEST_POS[p], 2, &jet);
+        double truth[3], later[3];
+        geomag(2022.5, &TEST_POS[p], &truth);
+        geomag(2023.5, &TEST_POS[p], &later);
+        for (int i = 0; i < 3; ++i) {
+            CHECK( jet.mag[i]*1E9 == Approx(truth[i]*1E9).margin(1e-6) );
+            CHECK( jet.mag_rate[i]*1E9 == Approx((later[i] - truth[i])*1E9).margin(1e-6) );
+        }
+        for (int j = 0; j < 3; ++j) {
+            double plus[3], minus[3];
+            double pos_plus[3] = {TEST_POS[p][0], TEST_POS[p][1], TEST_POS[p][2]};
+            double pos_minus[3] = {TEST_POS[p][0], TEST_POS[p][1], TEST_POS[p][2]};
+            pos_plus[j] += h;
+            pos_minus[j] -= h;
+            struct geomag_jet jet_plus, jet_minus;
+            geomag_jet(&WMM2020, 2022.5, &pos_plus, 1, &jet_plus);
+            geomag_jet(&WMM2020, 2022.5, &pos_minus, 1, &jet_minus);
+            geomag(2022.5, &pos_plus, &plus);
+            geomag(2022.5, &pos_minus, &minus);
+            for (int i = 0; i < 3; ++i) {
+                // [nT/km] and [nT/km^2]
+                CHECK( jet.grad[i][j]*1E12 == Approx((plus[i] - minus[i]) / (2 * h)*1E12).margin(1e-4) );
+                for (int k = 0; k < 3; ++k) {
+                    const double fd = (jet_plus.grad[i][k] - jet_minus.grad[i][k]) / (2 * h);
+                    CHECK( jet.hess[i][j][k]*1E15 == Approx(fd*1E15).margin(1e-4) );
+                }
+            }
+        }
+        CHECK( (jet.grad[0][0] + jet.grad[1][1] + jet.grad[2][2])*1E12 == Approx(0.0).margin(1e-9) );
+
+        // Orders out of range are clamped
+        struct geomag_jet high, low;
+        geomag_jet(&WMM2020, 2022.5, &TEST_POS[p], 7, &high);
+        geomag_jet(&WMM2020, 2022.5, &TEST_POS[p], -1, &low);
+        for (int i = 0; i < 3; ++i) {
+            CHECK( low.mag[i] == jet.mag[i] );
+            for (int j = 0; j < 3; ++j) {
+                CHECK( high.grad[i][j] == jet.grad[i][j] );
+                for (int k = 0; k < 3; ++k) {
+                    CHECK( high.hess[i][j][k] == jet.hess[i][j][k] );
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "geomag geodetic NED matches WMM2020 test values", "[geodetic]" ) {
+    // WMM2020 test values from `wmmtestgen.py`, X Y Z [nT]
+    const double deg = 3.14159265358979323846 / 180.0;
+    const double lla[3][3] = {{80 * deg, 0 * deg, 0.0}, {0 * deg, 120 * deg, 100000.0}, {-80 * deg, 240 * deg, 0.0}};
+    const double truth[3][3] = {{6570.4, -146.3, 54606.0}, {37636.7, 104.9, -10474.8}, {6016.5, 15776.7, -52251.6}};
+    const double dyear[3] = {2020.0, 2020.0, 2022.5};
+    double out[3][3];
+    geomag_geodetic_batch(&WMM2020, 3, dyear, lla, out);
+    for (int i = 0; i < 3; ++i) {
+        double single[3], pos[3], mag[3], ned[3][3];
+        geomag_eval_geodetic(&WMM2020, dyear[i], &lla[i], &single);
+        geomag_geodetic_to_itrf(lla[i][0], lla[i][1], lla[i][2], &pos);
+        geomag_ned_frame(lla[i][0], lla[i][1], ned);
+        geomag(dyear[i], &pos, &mag);
+        for (int j = 0; j < 3; ++j) {
+            const double rotated = ned[j][0] * mag[0] + ned[j][1] * mag[1] + ned[j][2] * mag[2];
+            CHECK( out[i][j]*1E9 == Approx(truth[i][j]).margin(0.05) );
+            CHECK( out[i][j] == single[j] );
+            CHECK( out[i][j]*1E9 == Approx(rotated*1E9).margin(1e-9) );
+        }
+    }
+}
+
+TEST_CASE( "geomag elements batch matches scalar post-processing", "[geodetic]" ) {
+    const double deg = 3.14159265358979323846 / 180.0;
+    const size_t count = 200;
+    double lla[count][3], dyear[count];
+    for (size_t i = 0; i < count; ++i) {
+        lla[i][0] = (double) i * 0.89 * deg - 89 * deg;
+        lla[i][1] = (double) i * 7.3 * deg;
+        lla[i][2] = (double) (i % 5) * 20000.0;
+        dyear[i] = 2020.0 + (double) i / count;
+    }
+    struct geomag_elements elements[count];
+    geomag_elements_batch(&WMM2020, count, dyear, lla, elements);
+    for (size_t i = 0; i < count; ++i) {
+        double ned[3];
+        geomag_eval_geodetic(&WMM2020, dyear[i], &lla[i], &ned);
+        const double h = std::hypot(ned[0], ned[1]);
+        CHECK( elements[i].h == Approx(h) );
+        CHECK( elements[i].f == Approx(std::sqrt(h * h + ned[2] * ned[2])) );
+        CHECK( elements[i].decl == Approx(std::atan2(ned[1], ned[0])) );
+        CHECK( elements[i].incl == Approx(std::atan2(ned[2], h)) );
+        const double grid_north = (lla[i][0] >= 0) ? lla[i][1] : -lla[i][1];
+        const double gv = elements[i].gv;
+        CHECK( gv > -M_PI );
+        CHECK( gv <= M_PI );
+        CHECK( std::cos(gv) == Approx(std::cos(elements[i].decl - grid_north)).margin(1e-12) );
+        CHECK( std::sin(gv) == Approx(std::sin(elements[i].decl - grid_north)).margin(1e-12) );
+    }
+}
+
+TEST_CASE( "geomag batch frames rotate the ITRF field", "[frame]" ) {
+    const double dyear[4] = {2000.0 + 0.5 / 366.0, 2021.25, 2022.5, 2024.75};
+    const double s = std::sqrt(0.5);
+    const double quat[4][4] = {{1, 0, 0, 0}, {s, 0, 0, s}, {s, 0, 0, s}, {0.5, 0.5, 0.5, 0.5}};
+    double itrf[4][3], ned[4][3], enu[4][3], sph[4][3], eci[4][3], body[4][3];
+    geomag_batch_frame(&WMM2020, 4, dyear, TEST_POS, GEOMAG_FRAME_ITRF, NULL, itrf);
+    geomag_batch_frame(&WMM2020, 4, dyear, TEST_POS, GEOMAG_FRAME_NED, NULL, ned);
+    geomag_batch_frame(&WMM2020, 4, dyear, TEST_POS, GEOMAG_FRAME_ENU, NULL, enu);
+    geomag_batch_frame(&WMM2020, 4, dyear, TEST_POS, GEOMAG_FRAME_SPHERICAL, NULL, sph);
+    geomag_batch_frame(&WMM2020, 4, dyear, TEST_POS, GEOMAG_FRAME_ECI, NULL, eci);
+    geomag_batch_frame(&WMM2020, 4, dyear, TEST_POS, GEOMAG_FRAME_BODY, quat, body);
+
+    // J2000.0 is at GMST 280.46061837 deg
+    CHECK( geomag_gmst(dyear[0]) == Approx(280.46061837 * M_PI / 180.0).margin(1e-9) );
+
+    for (int i = 0; i < 4; ++i) {
+        double truth[3];
+        geomag(dyear[i], &TEST_POS[i], &truth);
+        CHECK( itrf[i][0] == truth[0] );
+        CHECK( itrf[i][1] == truth[1] );
+        CHECK( itrf[i][2] == truth[2] );
+
+        double lla[3], ned_truth[3];
+        geomag_itrf_to_geodetic(&TEST_POS[i], &lla[0], &lla[1], &lla[2]);
+        geomag_eval_geodetic(&WMM2020, dyear[i], &lla, &ned_truth);
+        for (int j = 0; j < 3; ++j) {
+            CHECK( ned[i][j]*1E9 == Approx(ned_truth[j]*1E9).margin(1e-6) );
+        }
+        CHECK( enu[i][0] == ned[i][1] );
+        CHECK( enu[i][1] == ned[i][0] );
+        CHECK( enu[i][2] == -ned[i][2] );
+
+        // Radial component and magnitude
+        const double *p = TEST_POS[i];
+        const double r = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        const double b_r = (p[0] * truth[0] + p[1] * truth[1] + p[2] * truth[2]) / r;
+        const double b = std::sqrt(truth[0] * truth[0] + truth[1] * truth[1] + truth[2] * truth[2]);
+        CHECK( sph[i][0]*1E9 == Approx(b_r*1E9).margin(1e-6) );
+        CHECK( std::sqrt(sph[i][0] * sph[i][0] + sph[i][1] * sph[i][1] + sph[i][2] * sph[i][2])*1E9
+            == Approx(b*1E9).margin(1e-6) );
+
+        // ECI keeps z and the magnitude, and rotates by GMST about z
+        const double g = geomag_gmst(dyear[i]);
+        CHECK( eci[i][0]*1E9 == Approx((std::cos(g) * truth[0] - std::sin(g) * truth[1])*1E9).margin(1e-6) );
+        CHECK( eci[i][2] == truth[2] );
+    }
+
+    // Identity, then body x along ECI y, then a cyclic permutation of axes
+    for (int j = 0; j < 3; ++j) {
+        CHECK( body[0][j]*1E9 == Approx(eci[0][j]*1E9).margin(1e-6) );
+    }
+    CHECK( body[1][0]*1E9 == Approx(eci[1][1]*1E9).margin(1e-6) );
+    CHECK( body[1][1]*1E9 == Approx(-eci[1][0]*1E9).margin(1e-6) );
+    CHECK( body[1][2]*1E9 == Approx(eci[1][2]*1E9).margin(1e-6) );
+    CHECK( body[3][0]*1E9 == Approx(eci[3][1]*1E9).margin(1e-6) );
+    CHECK( body[3][1]*1E9 == Approx(eci[3][2]*1E9).margin(1e-6) );
+    CHECK( body[3][2]*1E9 == Approx(eci[3][0]*1E9).margin(1e-6) );
+}
+
+TEST_CASE( "geomag strided batch reads and writes arrays of structs", "[batch]" ) {
+    struct state {
+        double pos[3];
+        double vel[3];
+        double quat[4];
+        double dyear;
+        double mag[3];
+    };
+    struct state states[4];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            states[i].pos[j] = TEST_POS[i][j];
+            states[i].vel[j] = 0.0;
+        }
+        states[i].quat[0] = 1.0;
+        states[i].quat[1] = states[i].quat[2] = states[i].quat[3] = 0.0;
+        states[i].dyear = 2020.0 + i;
+    }
+
+    geomag_batch_strided(
+        &WMM2020, 4, &states[0].dyear, sizeof(struct state), states[0].pos, sizeof(struct state),
+        GEOMAG_FRAME_BODY, states[0].quat, sizeof(struct state), states[0].mag, sizeof(struct state)
+    );
+    double eci[4][3];
+    const double dyear[4] = {2020.0, 2021.0, 2022.0, 2023.0};
+    geomag_batch_frame(&WMM2020, 4, dyear, TEST_POS, GEOMAG_FRAME_ECI, NULL, eci);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            CHECK( states[i].mag[j] == eci[i][j] );
+            CHECK( states[i].vel[j] == 0.0 );
+        }
+    }
+
+    // A zero stride broadcasts one epoch, into a plain output array
+    const double epoch = 2022.5;
+    double itrf[4][3];
+    geomag_batch_strided(
+        &WMM2020, 4, &epoch, 0, states[0].pos, sizeof(struct state), GEOMAG_FRAME_ITRF, NULL, 0,
+        itrf[0], sizeof(itrf[0])
+    );
+    for (int i = 0; i < 4; ++i) {
+        double truth[3];
+        geomag(epoch, &TEST_POS[i], &truth);
+        CHECK( itrf[i][0] == truth[0] );
+        CHECK( itrf[i][1] == truth[1] );
+        CHECK( itrf[i][2] == truth[2] );
+    }
+}
+
+TEST_CASE( "geomag grid matches pointwise evaluation", "[grid]" ) {
+    const double deg = 3.14159265358979323846 / 180.0;
+    const double heights[3] = {0.0, 400000.0, 35786000.0};
+    double lats[7], lons[24];
+    for (int i = 0; i < 7; ++i) {
+        lats[i] = (-90.0 + 30.0 * i) * deg;
+    }
+    for (int i = 0; i < 24; ++i) {
+        lons[i] = (-180.0 + 15.0 * i + 0.3) * deg;
+    }
+    static double grid[3 * 7 * 24][3];
+    geomag_grid(&WMM2020, 2022.5, 3, heights, 7, lats, 24, lons, grid);
+    for (int h = 0; h < 3; ++h) {
+        for (int i = 0; i < 7; ++i) {
+            for (int j = 0; j < 24; ++j) {
+                double pos[3], truth[3];
+                geomag_geodetic_to_itrf(lats[i], lons[j], heights[h], &pos);
+                geomag(2022.5, &pos, &truth);
+                const double *out = grid[(h * 7 + i) * 24 + j];
+                CHECK( out[0]*1E9 == Approx(truth[0]*1E9).margin(1e-6) );
+                CHECK( out[1]*1E9 == Approx(truth[1]*1E9).margin(1e-6) );
+                CHECK( out[2]*1E9 == Approx(truth[2]*1E9).margin(1e-6) );
+            }
+        }
+    }
+}
@@ -0,0 +1,138 @@
+// geomag_arrow_test.cpp Hand-written tests for the Arrow C Data Interface adapter
+
+#include "catch.hpp"
+
+#include <cstdint>
+#include <string>
+
+extern "C" {
+    #include "../geomag_arrow.h"
+}
+
+static const double POS[5][3] = {
+    {7000000.0, 0.0, 0.0},
+    {1111164.8708100126, 0.0, 6259542.961028692},
+    {-3189068.4999999986, 5523628.670817468, 0.0},
+    {-555582.4354050067, -962297.0059143245, -6259542.961028692},
+    {0.0, 0.0, -7000000.0},
+};
+
+static void no_release_schema(struct ArrowSchema *schema) {
+    schema->release = nullptr;
+}
+
+static void no_release_array(struct ArrowArray *array) {
+    array->release = nullptr;
+}
+
+// Borrowed input, a struct of float64 columns named as given
+struct input {
+    const char *names[4];
+    struct ArrowSchema child_schemas[4];
+    struct ArrowSchema *child_schema_ptrs[4];
+    struct ArrowSchema schema;
+    double values[4][5];
+    uint8_t validity[4];
+    const void *child_buffers[4][2];
+    struct ArrowArray children[4];
+    struct ArrowArray *child_ptrs[4];
+    const void *buffers[1];
+    struct ArrowArray array;
+
+    input(int num_cols, int64_t offset, int64_t length) {
+        static const char *const NAMES[4] = {"dyear", "z", "y", "x"};
+        for (int c = 0; c < num_cols; ++c) {
+            const int k = c + 4 - num_cols;
+            names[c] = NAMES[k];
+            child_schemas[c] = {"g", names[c], nullptr, 0, 0, nullptr, nullptr, no_release_schema, nullptr};
+            child_schema_ptrs[c] = &child_schemas[c];
+            for (int i = 0; i < 5; ++i) {
+                values[c][i] = (k > 0) ? POS[i][3 - k] : 2020.0 + i;
+            }
+            validity[c] = 0xff;
+            child_buffers[c][0] = &validity[c];
+            child_buffers[c][1] = values[c];
+            children[c] = {5, 0, 0, 2, 0, child_buffers[c], nullptr, nullptr, no_release_array, nullptr};
+            child_ptrs[c] = &children[c];
+        }
+        schema = {"+s", nullptr, nullptr, 0, num_cols, child_schema_ptrs, nullptr, no_release_schema, nullptr};
+        buffers[0] = nullptr;
+        array = {length, 0, offset, 1, num_cols, buffers, child_ptrs, nullptr, no_release_array, nullptr};
+    }
+};
+
+TEST_CASE( "geomag arrow batch matches geomag", "[arrow]" ) {
+    input in(3, 1, 4);
+    struct ArrowSchema out_schema;
+    struct ArrowArray out;
+    REQUIRE( geomag_arrow_eval(&WMM2020, &in.schema, &in.array, 2022.5, &out_schema, &out) == 0 );
+    REQUIRE( out.length == 4 );
+    CHECK( out.null_count == 0 );
+    CHECK( std::string(out_schema.format) == "+s" );
+    REQUIRE( out_schema.n_children == 3 );
+    CHECK( std::string(out_schema.children[0]->name) == "bx" );
+    CHECK( std::string(out_schema.children[2]->format) == "g" );
+    for (int64_t i = 0; i < 4; ++i) {
+        double truth[3];
+        geomag(2022.5, &POS[i + 1], &truth);
+        for (int c = 0; c < 3; ++c) {
+            const double *col = static_cast<const double *>(out.children[c]->buffers[1]);
+            CHECK( col[out.children[c]->offset + i] == truth[c] );
+        }
+    }
+    out.release(&out);
+    out_schema.release(&out_schema);
+    CHECK( out.release == nullptr );
+    CHECK( out_schema.release == nullptr );
+}
+
+TEST_CASE( "geomag arrow batch reads times and nulls", "[arrow]" ) {
+    input in(4, 0, 5);
+    // Null position in row 3, from the y column
+    in.validity[2] = 0xff & ~(1 << 3);
+    in.children[2].null_count = 1;
+    struct ArrowSchema out_schema;
+    struct ArrowArray out;
+    REQUIRE( geomag_arrow_eval(&WMM2020, &in.schema, &in.array, 0.0, &out_schema, &out) == 0 );
+    CHECK( out.null_count == 1 );
+    const uint8_t *validity = static_cast<const uint8_t *>(out.buffers[0]);
+    REQUIRE( validity != nullptr );
+    for (int64_t i = 0; i < 5; ++i) {
+        CHECK( ((validity[0] >> i) & 1) == (i == 3 ? 0 : 1) );
+        if (i == 3) {
+            continue;
+        }
+        double truth[3];
+        geomag(2020.0 + i, &POS[i], &truth);
+        const double *bz = static_cast<const double *>(out.children[2]->buffers[1]);
+        CHECK( bz[i] == truth[2] );
+    }
+    out.release(&out);
+    out_schema.release(&out_schema);
+
+    // Missing columns are rejected
+    input missing(2, 0, 5);
+    CHECK( geomag_arrow_eval(&WMM2020, &missing.schema, &missing.array, 2022.5, &out_schema, &out) == -1 );
+}
+
+TEST_CASE( "geomag arrow columns outlive the batch once moved out", "[arrow]" ) {
+    input in(3, 0, 5);
+    struct ArrowSchema out_schema;
+    struct ArrowArray out;
+    REQUIRE( geomag_arrow_eval(&WMM2020, &in.schema, &in.array, 2022.5, &out_schema, &out) == 0 );
+    // Moving a child copies it and marks the original released
+    struct ArrowArray by = *out.children[1];
+    out.children[1]->release = nullptr;
+    out.release(&out);
+    out_schema.release(&out_schema);
+
+    REQUIRE( by.release != nullptr );
+    const double *col = static_cast<const double *>(by.buffers[1]);
+    for (int64_t i = 0; i < 5; ++i) {
+        double truth[3];
+        geomag(2022.5, &POS[i], &truth);
+        CHECK( col[i] == truth[1] );
+    }
+    by.release(&by);
+    CHECK( by.release == nullptr );
+}
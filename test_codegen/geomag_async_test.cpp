@@ -0,0 +1,93 @@
+// geomag_async_test.cpp Hand-written tests for the offload queue
+
+#include "catch.hpp"
+
+#include <thread>
+
+extern "C" {
+    #include "../geomag_async.h"
+}
+
+TEST_CASE( "geomag async queue evaluates in order and rejects on overflow", "[async]" ) {
+    geomag_async *queue = geomag_async_new(&WMM2020, 3);
+    REQUIRE( queue != nullptr );
+    const double pos[3] = {1111164.8708100126, 0.0, 6259542.961028692};
+    double truth[3];
+    geomag_eval(&WMM2020, 2020.0, &pos, &truth);
+
+    geomag_async_result result;
+    CHECK( geomag_async_poll(queue, 0.0, &result) == 0 );
+    // Rounded up to 4 slots
+    for (int i = 0; i < 4; ++i) {
+        CHECK( geomag_async_post(queue, 0.001 * i, 2020.0 + i, &pos) == 0 );
+    }
+    CHECK( geomag_async_post(queue, 0.004, 2024.0, &pos) == -1 );
+    CHECK( geomag_async_poll(queue, 0.004, &result) == 0 );
+
+    CHECK( geomag_async_work(queue) == 4 );
+    CHECK( geomag_async_work(queue) == 0 );
+    // Still full until results are collected
+    CHECK( geomag_async_post(queue, 0.004, 2024.0, &pos) == -1 );
+    REQUIRE( geomag_async_poll(queue, 0.005, &result) == 1 );
+    CHECK( result.dyear == 2020.0 );
+    CHECK( result.latency == Approx(0.005) );
+    for (int k = 0; k < 3; ++k) {
+        CHECK( result.pos_itrf[k] == pos[k] );
+        CHECK( result.mag_itrf[k] == truth[k] );
+    }
+    CHECK( geomag_async_post(queue, 0.005, 2024.0, &pos) == 0 );
+    // The newest finished result skips the rest
+    REQUIRE( geomag_async_latest(queue, 0.006, &result) == 1 );
+    CHECK( result.dyear == 2023.0 );
+    CHECK( geomag_async_latest(queue, 0.006, &result) == 0 );
+    geomag_async_work(queue);
+    REQUIRE( geomag_async_poll(queue, 0.0055, &result) == 1 );
+    CHECK( result.dyear == 2024.0 );
+
+    geomag_async_stats stats;
+    geomag_async_get_stats(queue, &stats);
+    CHECK( stats.posted == 5 );
+    CHECK( stats.overflows == 2 );
+    CHECK( stats.collected == 3 );
+    CHECK( stats.skipped == 2 );
+    CHECK( stats.latency_min == Approx(0.0005) );
+    CHECK( stats.latency_max == Approx(0.005) );
+    // 500 us, 3 ms and 5 ms fall in the 512 us, 4.096 ms and 8.192 ms buckets
+    CHECK( stats.histogram[9] == 1 );
+    CHECK( stats.histogram[12] == 1 );
+    CHECK( stats.histogram[13] == 1 );
+    CHECK( geomag_async_percentile(&stats, 0.0) == Approx(0.000512) );
+    CHECK( geomag_async_percentile(&stats, 0.5) == Approx(0.004096) );
+    CHECK( geomag_async_percentile(&stats, 1.0) == Approx(0.005) );
+    geomag_async_free(queue);
+}
+
+TEST_CASE( "geomag async queue works with a worker thread", "[async]" ) {
+    geomag_async *queue = geomag_async_new(&WMM2020, 8);
+    REQUIRE( queue != nullptr );
+    std::thread worker(geomag_async_run, queue);
+    int posted = 0, collected = 0;
+    while (collected < 1000) {
+        geomag_async_result result;
+        while (geomag_async_poll(queue, 0.0, &result) == 1) {
+            double truth[3];
+            geomag_eval(&WMM2020, result.dyear, &result.pos_itrf, &truth);
+            for (int k = 0; k < 3; ++k) {
+                CHECK( result.mag_itrf[k] == truth[k] );
+            }
+            CHECK( result.dyear == 2020.0 + 0.001 * collected );
+            ++collected;
+        }
+        // Rejected posts are simply made again
+        const double pos[3] = {7e6, 1e4 * posted, -3e6};
+        posted += (geomag_async_post(queue, 0.0, 2020.0 + 0.001 * posted, &pos) == 0);
+    }
+    geomag_async_stop(queue);
+    worker.join();
+
+    geomag_async_stats stats;
+    geomag_async_get_stats(queue, &stats);
+    CHECK( stats.posted == (uint64_t) posted );
+    CHECK( stats.collected == 1000 );
+    geomag_async_free(queue);
+}
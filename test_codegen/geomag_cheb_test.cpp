@@ -0,0 +1,71 @@
+// geomag_cheb_test.cpp Hand-written tests for Chebyshev compression
+
+#include "catch.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+extern "C" {
+    #include "../geomag_cheb.h"
+}
+
+// Inclined circular LEO in ITRF, time in seconds from 2022.5
+static void leo_ephemeris(void *, double t, double *dyear, double (*pos_itrf)[3]) {
+    const double r = 6771200.0;
+    const double angle = 7600.0 / r * t;
+    const double inc = 0.9;
+    const double earth_rot = -7.2921159e-5 * t;
+    const double x = r * std::cos(angle);
+    const double y = r * std::sin(angle) * std::cos(inc);
+    const double z = r * std::sin(angle) * std::sin(inc);
+    *dyear = 2022.5 + t / (365.25 * 86400.0);
+    (*pos_itrf)[0] = std::cos(earth_rot) * x - std::sin(earth_rot) * y;
+    (*pos_itrf)[1] = std::sin(earth_rot) * x + std::cos(earth_rot) * y;
+    (*pos_itrf)[2] = z;
+}
+
+TEST_CASE( "geomag Chebyshev fit matches the field along an ephemeris", "[cheb]" ) {
+    const double tol = 0.1e-9;
+    std::vector<struct geomag_cheb_segment> segments(2000);
+    struct geomag_cheb cheb;
+    geomag_cheb_init(&cheb, segments.data(), segments.size());
+    REQUIRE( geomag_cheb_fit(&cheb, &WMM2020, leo_ephemeris, NULL, 0.0, 86400.0, 12, 1200.0, tol) == 0 );
+    CHECK( cheb.count >= 72 );
+    CHECK( cheb.count < 1000 );
+    CHECK( cheb.segments[0].t_begin == 0.0 );
+    CHECK( cheb.segments[cheb.count - 1].t_end == 86400.0 );
+
+    std::FILE *file = std::tmpfile();
+    REQUIRE( file != NULL );
+    REQUIRE( geomag_cheb_write(&cheb, file) == 0 );
+    std::rewind(file);
+    std::vector<struct geomag_cheb_segment> read_segments(cheb.count);
+    struct geomag_cheb read_cheb;
+    geomag_cheb_init(&read_cheb, read_segments.data(), read_segments.size());
+    REQUIRE( geomag_cheb_read(&read_cheb, file) == 0 );
+    std::fclose(file);
+    CHECK( read_cheb.count == cheb.count );
+
+    for (int i = 0; i < 2000; ++i) {
+        const double t = 43.2 * i + 0.37;
+        double dyear, pos[3], truth[3], out[3], read_out[3];
+        leo_ephemeris(NULL, t, &dyear, &pos);
+        geomag(dyear, &pos, &truth);
+        geomag_cheb_eval(&cheb, t, &out);
+        geomag_cheb_eval(&read_cheb, t, &read_out);
+        CHECK( out[0]*1E9 == Approx(truth[0]*1E9).margin(tol*1E9) );
+        CHECK( out[1]*1E9 == Approx(truth[1]*1E9).margin(tol*1E9) );
+        CHECK( out[2]*1E9 == Approx(truth[2]*1E9).margin(tol*1E9) );
+        CHECK( read_out[0] == out[0] );
+        CHECK( read_out[1] == out[1] );
+        CHECK( read_out[2] == out[2] );
+    }
+}
+
+TEST_CASE( "geomag Chebyshev fit reports running out of segments", "[cheb]" ) {
+    struct geomag_cheb_segment segments[4];
+    struct geomag_cheb cheb;
+    geomag_cheb_init(&cheb, segments, 4);
+    CHECK( geomag_cheb_fit(&cheb, &WMM2020, leo_ephemeris, NULL, 0.0, 86400.0, 12, 1200.0, 0.1e-9) == -1 );
+}
@@ -0,0 +1,47 @@
+// geomag_cof_test.cpp Hand-written tests for loading COF files
+
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+extern "C" {
+    #include "../geomag_cof.h"
+}
+
+TEST_CASE( "geomag model read from a COF file matches the parsed text", "[cof]" ) {
+    std::ifstream stream("WMM2015v2.COF");
+    std::stringstream contents;
+    contents << stream.rdbuf();
+    struct geomag_model parsed, read;
+    REQUIRE( geomag_model_parse_cof(contents.str().c_str(), &parsed) == 0 );
+    std::FILE *file = std::fopen("WMM2015v2.COF", "rb");
+    REQUIRE( file != NULL );
+    REQUIRE( geomag_model_read_cof(file, &read) == 0 );
+    std::fclose(file);
+    CHECK( read.epoch == parsed.epoch );
+    for (int i = 0; i < WMM_TOT_COEFFS; ++i) {
+        CHECK( read.coeffs[i].main_field_c == parsed.coeffs[i].main_field_c );
+        CHECK( read.coeffs[i].main_field_s == parsed.coeffs[i].main_field_s );
+        CHECK( read.coeffs[i].sec_var_c == parsed.coeffs[i].sec_var_c );
+        CHECK( read.coeffs[i].sec_var_s == parsed.coeffs[i].sec_var_s );
+    }
+}
+
+TEST_CASE( "geomag model read rejects empty and truncated COF files", "[cof]" ) {
+    struct geomag_model model;
+    std::FILE *file = std::tmpfile();
+    REQUIRE( file != NULL );
+    CHECK( geomag_model_read_cof(file, &model) == -1 );
+    std::fclose(file);
+
+    file = std::tmpfile();
+    REQUIRE( file != NULL );
+    const char text[] = "2020.0 WMM-2020\n  1  0  -29404.5  0.0  6.7  0.0\n";
+    std::fwrite(text, 1, sizeof(text) - 1, file);
+    std::rewind(file);
+    CHECK( geomag_model_read_cof(file, &model) == -1 );
+    std::fclose(file);
+}
@@ -0,0 +1,109 @@
+// geomag_dipole_test.cpp Hand-written tests for dipole magnetic coordinates
+
+#include "catch.hpp"
+
+#include <cmath>
+
+extern "C" {
+    #include "../geomag_dipole.h"
+}
+
+static const double RE = 6371200.0;
+static const double DEG = M_PI / 180.0;
+
+static struct geomag_model zero_model() {
+    struct geomag_model model;
+    for (int i = 0; i < WMM_TOT_COEFFS; ++i) {
+        model.coeffs[i].main_field_c = 0;
+        model.coeffs[i].main_field_s = 0;
+        model.coeffs[i].sec_var_c = 0;
+        model.coeffs[i].sec_var_s = 0;
+    }
+    model.epoch = 2020.0;
+    return model;
+}
+
+TEST_CASE( "geomag dipole pole matches the WMM2020 report", "[dipole]" ) {
+    // WMM2020 technical report, geomagnetic north pole at 2020.0
+    struct geomag_dipole dipole;
+    geomag_dipole_init(&WMM2020, 2020.0, 0, &dipole);
+    const double *z = dipole.rot[2];
+    const double surface[3] = {RE * z[0], RE * z[1], RE * z[2]};
+    double lat, lon, height;
+    geomag_itrf_to_geodetic(&surface, &lat, &lon, &height);
+    CHECK( lat / DEG == Approx(80.65).margin(0.01) );
+    CHECK( lon / DEG == Approx(-72.68).margin(0.01) );
+    CHECK( dipole.center[0] == 0.0 );
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            const double d = dipole.rot[i][0] * dipole.rot[j][0] + dipole.rot[i][1] * dipole.rot[j][1]
+                + dipole.rot[i][2] * dipole.rot[j][2];
+            CHECK( d == Approx(i == j ? 1.0 : 0.0).margin(1e-15) );
+        }
+    }
+
+    // The pole itself is at magnetic latitude 90
+    double pos[1][3] = {{2 * RE * z[0], 2 * RE * z[1], 2 * RE * z[2]}}, coords[1][3];
+    geomag_dipole_coords(&dipole, 1, pos, coords);
+    CHECK( coords[0][0] == Approx(M_PI / 2) );
+    CHECK( coords[0][2] == Approx(2 * RE) );
+}
+
+TEST_CASE( "geomag eccentric dipole offset", "[dipole]" ) {
+    // An axial dipole offset by d along z has g20 = 2 g10 d / R
+    struct geomag_model model = zero_model();
+    model.coeffs[1].main_field_c = -30000.0;
+    model.coeffs[2].main_field_c = -3000.0;
+    struct geomag_dipole dipole;
+    geomag_dipole_init(&model, 2020.0, 1, &dipole);
+    CHECK( dipole.center[0] == Approx(0.0).margin(1e-9) );
+    CHECK( dipole.center[1] == Approx(0.0).margin(1e-9) );
+    CHECK( dipole.center[2] == Approx(0.05 * RE) );
+    CHECK( dipole.b0 == Approx(30000e-9) );
+
+    // WMM2020 eccentric dipole is offset about 570 km into the Pacific
+    geomag_dipole_init(&WMM2020, 2022.5, 1, &dipole);
+    const double *c = dipole.center;
+    const double offset = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+    CHECK( offset > 500e3 );
+    CHECK( offset < 650e3 );
+    CHECK( std::atan2(c[1], c[0]) / DEG > 120.0 );
+    CHECK( c[2] > 0 );
+}
+
+TEST_CASE( "geomag dipole batch coordinates and MLT", "[dipole]" ) {
+    struct geomag_model model = zero_model();
+    model.coeffs[1].main_field_c = -30000.0;
+    struct geomag_dipole dipole;
+    geomag_dipole_init(&model, 2020.0, 0, &dipole);
+
+    // Axial dipole, so magnetic coordinates are geocentric
+    const size_t count = 100;
+    double pos[count][3], coords[count][3], sun[count][3], mlt[count];
+    for (size_t i = 0; i < count; ++i) {
+        const double lat = (double) i * 1.7 * DEG - 80 * DEG;
+        const double lon = (double) i * 3.6 * DEG - M_PI;
+        pos[i][0] = RE * std::cos(lat) * std::cos(lon);
+        pos[i][1] = RE * std::cos(lat) * std::sin(lon);
+        pos[i][2] = RE * std::sin(lat);
+        sun[i][0] = std::cos(lon);
+        sun[i][1] = std::sin(lon);
+        sun[i][2] = 0.3;
+    }
+    geomag_dipole_coords(&dipole, count, pos, coords);
+    geomag_dipole_mlt(&dipole, count, coords, sun, mlt);
+    for (size_t i = 0; i < count; ++i) {
+        CHECK( coords[i][0] == Approx((double) i * 1.7 * DEG - 80 * DEG).margin(1e-12) );
+        CHECK( std::cos(coords[i][1]) == Approx(std::cos((double) i * 3.6 * DEG - M_PI)).margin(1e-12) );
+        CHECK( std::sin(coords[i][1]) == Approx(std::sin((double) i * 3.6 * DEG - M_PI)).margin(1e-12) );
+        CHECK( coords[i][2] == Approx(RE) );
+        // Every position is under the Sun
+        CHECK( std::fabs(mlt[i] - 12.0) < 1e-9 );
+    }
+
+    // Opposite the Sun is midnight
+    sun[0][0] = -sun[0][0];
+    sun[0][1] = -sun[0][1];
+    geomag_dipole_mlt(&dipole, 1, coords, sun, mlt);
+    CHECK( std::fmod(mlt[0] + 12.0, 24.0) == Approx(12.0).margin(1e-9) );
+}
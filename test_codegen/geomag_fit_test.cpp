@@ -0,0 +1,89 @@
+// geomag_fit_test.cpp Hand-written tests for coefficient fitting
+
+#include "catch.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include "../geomag_fit.h"
+}
+
+static std::string read_cof(const char *name) {
+    std::ifstream file(name);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Observations of `truth` spread over the globe at 400 km altitude
+static void make_observations(
+    const struct geomag_model *truth, int count, std::vector<double> &dyear,
+    std::vector<double> &pos, std::vector<double> &mag
+) {
+    dyear.resize(count);
+    pos.resize(3 * count);
+    mag.resize(3 * count);
+    for (int i = 0; i < count; ++i) {
+        const double lat = std::asin(2.0 * (i + 0.5) / count - 1.0);
+        const double lon = 2.399963229728653 * i;
+        const double r = 6771200.0;
+        dyear[i] = 2020.0 + 4.0 * i / count;
+        pos[3 * i + 0] = r * std::cos(lat) * std::cos(lon);
+        pos[3 * i + 1] = r * std::cos(lat) * std::sin(lon);
+        pos[3 * i + 2] = r * std::sin(lat);
+        geomag_eval(truth, dyear[i], (const double (*)[3]) &pos[3 * i], (double (*)[3]) &mag[3 * i]);
+    }
+}
+
+TEST_CASE( "geomag COF writer round trips a WMM release", "[fit]" ) {
+    const std::string cof = read_cof("WMM2020.COF");
+    struct geomag_model model;
+    REQUIRE( geomag_model_parse_cof(cof.c_str(), &model) == 0 );
+    char text[8192];
+    const int len = geomag_model_write_cof(&model, "WMM-2020", "12/10/2019", text, sizeof(text));
+    REQUIRE( len > 0 );
+    REQUIRE( len < (int) sizeof(text) );
+    CHECK( std::string(text) == cof );
+    CHECK( geomag_model_write_cof(&model, "WMM-2020", "12/10/2019", NULL, 0) == len );
+}
+
+TEST_CASE( "geomag fit recovers coefficient corrections", "[fit]" ) {
+    static struct geomag_model truth;
+    truth = WMM2020;
+    truth.coeffs[1].main_field_c += 50.0;
+    truth.coeffs[14].main_field_s -= 30.0;
+    truth.coeffs[26].main_field_c += 5.0;
+    std::vector<double> dyear, pos, mag;
+    make_observations(&truth, 500, dyear, pos, mag);
+
+    static struct geomag_fit fit;
+    static struct geomag_fit other;
+    geomag_fit_init(&fit, 3);
+    geomag_fit_init(&other, 3);
+    geomag_fit_add(&fit, &WMM2020, 200, &dyear[0], (const double (*)[3]) &pos[0], (const double (*)[3]) &mag[0]);
+    geomag_fit_add(
+        &other, &WMM2020, 300, &dyear[200], (const double (*)[3]) &pos[3 * 200], (const double (*)[3]) &mag[3 * 200]
+    );
+    geomag_fit_merge(&fit, &other);
+    CHECK( fit.num_params == 15 );
+    CHECK( fit.num_obs == 500 );
+
+    static struct geomag_model corrected;
+    REQUIRE( geomag_fit_solve(&fit, 0.0, &WMM2020, &corrected) == 0 );
+    for (int i = 0; i < WMM_TOT_COEFFS; ++i) {
+        CHECK( corrected.coeffs[i].main_field_c == Approx(truth.coeffs[i].main_field_c).margin(1e-6) );
+        CHECK( corrected.coeffs[i].main_field_s == Approx(truth.coeffs[i].main_field_s).margin(1e-6) );
+    }
+}
+
+TEST_CASE( "geomag fit reports singular normal equations", "[fit]" ) {
+    static struct geomag_fit fit;
+    static struct geomag_model corrected;
+    geomag_fit_init(&fit, 2);
+    CHECK( geomag_fit_solve(&fit, 0.0, &WMM2020, &corrected) == -1 );
+    CHECK( geomag_fit_solve(&fit, 1.0, &WMM2020, &corrected) == 0 );
+}
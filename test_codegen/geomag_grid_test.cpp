@@ -0,0 +1,148 @@
+// geomag_grid_test.cpp Hand-written tests for streamed grid synthesis
+
+#include "catch.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+    #include "../geomag_grid.h"
+}
+
+static const double DEG = 3.14159265358979323846 / 180.0;
+
+struct collector {
+    std::vector<double> values;
+    size_t next_height = 0, next_lat = 0, num_lats = 0;
+    int calls = 0, stop_after = -1;
+    bool ordered = true;
+};
+
+static int collect(
+    void *user, size_t height_index, size_t lat_index, size_t num_rows, size_t num_lons, const double (*mag)[3]
+) {
+    collector *c = static_cast<collector *>(user);
+    c->ordered = c->ordered && height_index == c->next_height && lat_index == c->next_lat;
+    c->next_lat += num_rows;
+    if (c->next_lat == c->num_lats) {
+        c->next_lat = 0;
+        ++c->next_height;
+    }
+    for (size_t i = 0; i < num_rows * num_lons; ++i) {
+        c->values.insert(c->values.end(), mag[i], mag[i] + 3);
+    }
+    return ++c->calls == c->stop_after;
+}
+
+struct axes {
+    double heights[3] = {0.0, 100000.0, 1000000.0};
+    double lats[11];
+    double lons[36];
+    axes() {
+        for (int i = 0; i < 11; ++i) {
+            lats[i] = (-90.0 + 18.0 * i) * DEG;
+        }
+        for (int i = 0; i < 36; ++i) {
+            lons[i] = (-180.0 + 10.0 * i) * DEG;
+        }
+    }
+};
+
+TEST_CASE( "geomag grid stream matches the in-memory grid", "[grid]" ) {
+    axes a;
+    static double grid[3 * 11 * 36][3];
+    geomag_grid(&WMM2020, 2022.5, 3, a.heights, 11, a.lats, 36, a.lons, grid);
+    for (size_t depth = 1; depth <= 3; ++depth) {
+        std::vector<double> buffer(depth * 4 * 36 * 3);
+        collector c;
+        c.num_lats = 11;
+        const int status = geomag_grid_stream(
+            &WMM2020, 2022.5, 3, a.heights, 11, a.lats, 36, a.lons, 4, depth,
+            reinterpret_cast<double (*)[3]>(buffer.data()), collect, &c
+        );
+        CHECK( status == 0 );
+        CHECK( c.ordered );
+        CHECK( c.calls == 9 );
+        REQUIRE( c.values.size() == 3 * 11 * 36 * 3 );
+        CHECK( std::memcmp(c.values.data(), grid, sizeof(grid)) == 0 );
+    }
+
+    // The sink can stop the stream
+    std::vector<double> buffer(2 * 4 * 36 * 3);
+    collector c;
+    c.num_lats = 11;
+    c.stop_after = 2;
+    const int status = geomag_grid_stream(
+        &WMM2020, 2022.5, 3, a.heights, 11, a.lats, 36, a.lons, 4, 2,
+        reinterpret_cast<double (*)[3]>(buffer.data()), collect, &c
+    );
+    CHECK( status == -1 );
+    CHECK( c.calls == 2 );
+
+    // Empty tiles or buffers are rejected before any work
+    collector empty;
+    empty.num_lats = 11;
+    empty.stop_after = 100;
+    CHECK( geomag_grid_stream(
+        &WMM2020, 2022.5, 3, a.heights, 11, a.lats, 36, a.lons, 0, 2,
+        reinterpret_cast<double (*)[3]>(buffer.data()), collect, &empty
+    ) == -1 );
+    CHECK( geomag_grid_stream(
+        &WMM2020, 2022.5, 3, a.heights, 11, a.lats, 36, a.lons, 4, 0,
+        reinterpret_cast<double (*)[3]>(buffer.data()), collect, &empty
+    ) == -1 );
+    CHECK( empty.calls == 0 );
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static double get_double(const unsigned char *p) {
+    uint64_t bits = (uint64_t) get_u32(p) << 32 | get_u32(p + 4);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+TEST_CASE( "geomag grid streams to a NetCDF classic file", "[grid]" ) {
+    axes a;
+    std::FILE *file = std::tmpfile();
+    REQUIRE( file != nullptr );
+    REQUIRE( geomag_grid_netcdf_begin(file, 2022.5, 3, a.heights, 11, a.lats, 36, a.lons) == 0 );
+    std::vector<double> buffer(2 * 5 * 36 * 3);
+    REQUIRE( geomag_grid_stream(
+        &WMM2020, 2022.5, 3, a.heights, 11, a.lats, 36, a.lons, 5, 2,
+        reinterpret_cast<double (*)[3]>(buffer.data()), geomag_grid_netcdf_sink, file
+    ) == 0 );
+    const long size = std::ftell(file);
+    std::vector<unsigned char> bytes((size_t) size);
+    std::rewind(file);
+    REQUIRE( std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size() );
+    std::fclose(file);
+
+    CHECK( std::memcmp(bytes.data(), "CDF\2", 4) == 0 );
+    // Dimension list of four, the first named height of length 3
+    CHECK( get_u32(&bytes[8]) == 10 );
+    CHECK( get_u32(&bytes[12]) == 4 );
+    CHECK( get_u32(&bytes[16]) == 6 );
+    CHECK( std::memcmp(&bytes[20], "height\0\0", 8) == 0 );
+    CHECK( get_u32(&bytes[28]) == 3 );
+
+    // Field data is last, axes just before it
+    const size_t data = bytes.size() - 3 * 11 * 36 * 24;
+    const size_t lons = data - 36 * 8, lats = lons - 11 * 8, heights = lats - 3 * 8;
+    // The last header entry is the field's 64-bit begin offset
+    CHECK( get_u32(&bytes[heights - 4]) == data );
+    CHECK( get_double(&bytes[heights + 8]) == 100000.0 );
+    CHECK( get_double(&bytes[lats]) == Approx(-90.0) );
+    CHECK( get_double(&bytes[lons + 8]) == Approx(-170.0) );
+    double pos[3], truth[3];
+    geomag_geodetic_to_itrf(a.lats[10], a.lons[35], a.heights[2], &pos);
+    geomag(2022.5, &pos, &truth);
+    for (int k = 0; k < 3; ++k) {
+        CHECK( get_double(&bytes[bytes.size() - 24 + 8 * k])*1E9 == Approx(truth[k]*1E9).margin(1e-6) );
+    }
+}
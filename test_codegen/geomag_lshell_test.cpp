@@ -0,0 +1,86 @@
+// geomag_lshell_test.cpp Hand-written tests for L-shell computation
+
+#include "catch.hpp"
+
+#include <cmath>
+
+extern "C" {
+    #include "../geomag_lshell.h"
+}
+
+static const double RE = 6371200.0;
+
+// Axial dipole, where L = r / cos^2(lat) exactly
+static const struct geomag_model &axial_dipole() {
+    static struct geomag_model dipole;
+    for (int i = 0; i < WMM_TOT_COEFFS; ++i) {
+        dipole.coeffs[i].main_field_c = 0;
+        dipole.coeffs[i].main_field_s = 0;
+        dipole.coeffs[i].sec_var_c = 0;
+        dipole.coeffs[i].sec_var_s = 0;
+    }
+    dipole.epoch = 2020.0;
+    dipole.coeffs[1].main_field_c = -30000.0;
+    return dipole;
+}
+
+TEST_CASE( "geomag L-shell matches an axial dipole", "[lshell]" ) {
+    const struct geomag_model &dipole = axial_dipole();
+    const double radii[3] = {1.5, 2.0, 4.0};
+    const double lats[4] = {0.0, 10.0, 30.0, -40.0};
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            const double lat = lats[j] * M_PI / 180.0;
+            const double pos[3] = {radii[i] * RE * std::cos(lat), 0.0, radii[i] * RE * std::sin(lat)};
+            struct geomag_lshell lshell;
+            geomag_lshell(&dipole, 2020.0, &pos, NULL, &lshell);
+            const double l = radii[i] / (std::cos(lat) * std::cos(lat));
+            REQUIRE( lshell.status == GEOMAG_LSHELL_OK );
+            CHECK( lshell.l == Approx(l).epsilon(1e-3) );
+            CHECK( lshell.b0 * 1E9 == Approx(30000.0 / (l * l * l)).epsilon(1e-6) );
+            CHECK( lshell.b_ratio == Approx(lshell.b / lshell.b0) );
+        }
+    }
+}
+
+TEST_CASE( "geomag L-shell reports lost particles", "[lshell]" ) {
+    // Low over South America, the field line dips below 100 km before mirroring
+    const double lat = -10.0 * M_PI / 180.0;
+    const double lon = -60.0 * M_PI / 180.0;
+    const double r = RE + 110000.0;
+    const double pos[3] = {r * std::cos(lat) * std::cos(lon), r * std::cos(lat) * std::sin(lon), r * std::sin(lat)};
+    struct geomag_lshell lshell;
+    geomag_lshell(&WMM2020, 2022.5, &pos, NULL, &lshell);
+    CHECK( lshell.status == GEOMAG_LSHELL_LOST );
+    CHECK( lshell.l == 0.0 );
+}
+
+TEST_CASE( "geomag L-shell batch reuses cached cells", "[lshell]" ) {
+    double pos[4][3];
+    const double dyear[4] = {2022.5, 2022.5, 2022.5, 2022.5};
+    for (int i = 0; i < 4; ++i) {
+        // Pairs of positions 100 m apart, in cells far from each other
+        const double lat = (i < 2 ? 40.0 : -35.0) * M_PI / 180.0;
+        const double r = 2.0 * RE + 100.0 * (i % 2) + 500.0;
+        pos[i][0] = r * std::cos(lat);
+        pos[i][1] = 1000.0;
+        pos[i][2] = r * std::sin(lat);
+    }
+    struct geomag_lshell_cache_entry entries[64];
+    struct geomag_lshell_cache cache;
+    geomag_lshell_cache_init(&cache, entries, 64, 10000.0, 0.1);
+    struct geomag_lshell cached[4];
+    geomag_lshell_batch(&WMM2020, 4, dyear, pos, &cache, cached);
+    CHECK( cache.hits + cache.misses == 4 );
+    CHECK( cache.misses >= 2 );
+    for (int i = 0; i < 4; ++i) {
+        struct geomag_lshell exact;
+        geomag_lshell(&WMM2020, dyear[i], &pos[i], NULL, &exact);
+        REQUIRE( exact.status == GEOMAG_LSHELL_OK );
+        CHECK( cached[i].status == GEOMAG_LSHELL_OK );
+        CHECK( cached[i].b == Approx(exact.b) );
+        CHECK( cached[i].l == Approx(exact.l).epsilon(1e-3) );
+        CHECK( cached[i].b_ratio == Approx(exact.b_ratio).epsilon(1e-3) );
+        CHECK( exact.l > 2.0 );
+    }
+}
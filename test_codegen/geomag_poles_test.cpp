@@ -0,0 +1,65 @@
+// geomag_poles_test.cpp Hand-written tests for dip pole and equator location
+
+#include "catch.hpp"
+
+#include <cmath>
+
+extern "C" {
+    #include "../geomag_poles.h"
+}
+
+static const double DEG = M_PI / 180.0;
+
+TEST_CASE( "geomag geodetic conversion round trips", "[poles]" ) {
+    const double lats[5] = {-90.0, -45.0, 0.0, 30.0, 90.0};
+    const double heights[3] = {-1000.0, 0.0, 35786000.0};
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            double pos[3], lat, lon, height;
+            geomag_geodetic_to_itrf(lats[i] * DEG, 1.0, heights[j], &pos);
+            geomag_itrf_to_geodetic(&pos, &lat, &lon, &height);
+            CHECK( lat == Approx(lats[i] * DEG).margin(1e-12) );
+            CHECK( height == Approx(heights[j]).margin(1e-6) );
+            if (std::fabs(lats[i]) < 90.0) {
+                CHECK( lon == Approx(1.0) );
+            }
+        }
+    }
+    double pos[3];
+    geomag_geodetic_to_itrf(0.0, 0.0, 0.0, &pos);
+    CHECK( pos[0] == 6378137.0 );
+    geomag_geodetic_to_itrf(90.0 * DEG, 0.0, 0.0, &pos);
+    CHECK( pos[2] == Approx(6356752.314245) );
+}
+
+TEST_CASE( "geomag dip poles match the WMM2020 report", "[poles]" ) {
+    // WMM2020 technical report, dip poles at 2020.0
+    struct geomag_pole north, south;
+    REQUIRE( geomag_dip_pole(&WMM2020, 2020.0, 0.0, GEOMAG_POLE_NORTH, &north) == 0 );
+    REQUIRE( geomag_dip_pole(&WMM2020, 2020.0, 0.0, GEOMAG_POLE_SOUTH, &south) == 0 );
+    CHECK( north.lat / DEG == Approx(86.50).margin(0.01) );
+    CHECK( north.lon / DEG == Approx(164.04).margin(0.05) );
+    CHECK( south.lat / DEG == Approx(-64.07).margin(0.01) );
+    CHECK( south.lon / DEG == Approx(135.88).margin(0.05) );
+    CHECK( north.residual < 1e-15 );
+    CHECK( south.residual < 1e-15 );
+    CHECK( north.iterations < 20 );
+}
+
+TEST_CASE( "geomag dip equator has zero inclination", "[poles]" ) {
+    const size_t count = 360;
+    double lon[count], lat[count];
+    for (size_t i = 0; i < count; ++i) {
+        lon[i] = (double) i * DEG - M_PI;
+    }
+    REQUIRE( geomag_dip_equator(&WMM2020, 2022.5, 0.0, count, lon, lat) == 0 );
+    for (size_t i = 0; i < count; ++i) {
+        double pos[3], mag[3], ned[3][3];
+        geomag_geodetic_to_itrf(lat[i], lon[i], 0.0, &pos);
+        geomag_ned_frame(lat[i], lon[i], ned);
+        geomag_eval(&WMM2020, 2022.5, &pos, &mag);
+        const double down = ned[2][0] * mag[0] + ned[2][1] * mag[1] + ned[2][2] * mag[2];
+        CHECK( std::fabs(down) < 1e-14 );
+        CHECK( std::fabs(lat[i]) < 20.0 * DEG );
+    }
+}
@@ -0,0 +1,98 @@
+// geomag_swap_test.cpp Hand-written tests for hot-swapping the model
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+extern "C" {
+    #include "../geomag_swap.h"
+}
+
+TEST_CASE( "geomag model publish waits for holds of the old model", "[swap]" ) {
+    static geomag_model updated;
+    updated = WMM2020;
+    updated.epoch = 2021.0;
+    geomag_model_slot *slot = geomag_model_slot_new(&WMM2020);
+    REQUIRE( slot != nullptr );
+
+    geomag_model_hold old_hold;
+    geomag_model_acquire(slot, &old_hold);
+    CHECK( old_hold.model == &WMM2020 );
+
+    std::atomic<bool> published(false);
+    const geomag_model *previous = nullptr;
+    std::thread writer([&] {
+        previous = geomag_model_publish(slot, &updated);
+        published = true;
+    });
+    // New holds see the new model while the publish still waits
+    geomag_model_hold new_hold;
+    do {
+        geomag_model_acquire(slot, &new_hold);
+        geomag_model_release(slot, &new_hold);
+        std::this_thread::yield();
+    } while (new_hold.model != &updated);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK( !published );
+
+    geomag_model_release(slot, &old_hold);
+    writer.join();
+    CHECK( published );
+    CHECK( previous == &WMM2020 );
+    geomag_model_slot_free(slot);
+}
+
+TEST_CASE( "geomag model publish never retires a held model", "[swap]" ) {
+    static geomag_model models[2];
+    models[0] = WMM2020;
+    models[1] = WMM2020;
+    models[1].epoch = 2021.0;
+    std::atomic<bool> retired[2];
+    retired[0] = false;
+    retired[1] = true;
+    geomag_model_slot *slot = geomag_model_slot_new(&models[0]);
+    REQUIRE( slot != nullptr );
+
+    std::atomic<bool> done(false);
+    std::atomic<int> violations(0), evaluations(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            const double pos[3] = {1111164.8708100126, 0.0, 6259542.961028692};
+            while (!done) {
+                geomag_model_hold hold;
+                geomag_model_acquire(slot, &hold);
+                const int index = (hold.model == &models[1]);
+                violations += retired[index];
+                double mag[3];
+                geomag_eval(hold.model, 2022.5, &pos, &mag);
+                violations += retired[index];
+                geomag_model_release(slot, &hold);
+                ++evaluations;
+            }
+        });
+    }
+    for (int i = 1; i <= 50; ++i) {
+        // Let the readers run between publishes
+        const int seen = evaluations;
+        while (evaluations < seen + 4) {
+            std::this_thread::yield();
+        }
+        const int next = i % 2;
+        retired[next] = false;
+        const geomag_model *old = geomag_model_publish(slot, &models[next]);
+        CHECK( old == &models[1 - next] );
+        // Nothing holds the old model anymore
+        retired[1 - next] = true;
+    }
+    done = true;
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+    CHECK( violations == 0 );
+    CHECK( evaluations >= 200 );
+    geomag_model_slot_free(slot);
+}
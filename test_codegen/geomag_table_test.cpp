@@ -0,0 +1,109 @@
+// geomag_table_test.cpp Hand-written tests for precomputed field tables
+
+#include "catch.hpp"
+
+#include <cstring>
+#include <vector>
+
+extern "C" {
+    #include "../geomag_table.h"
+}
+
+static const double DEG = 3.14159265358979323846 / 180.0;
+
+static geomag_table_spec test_spec() {
+    geomag_table_spec spec;
+    spec.dyear0 = 2020.0;
+    spec.dyear1 = 2024.0;
+    spec.num_epochs = 3;
+    spec.height0 = 0.0;
+    spec.height1 = 500000.0;
+    spec.num_heights = 6;
+    spec.lat0 = -60.0 * DEG;
+    spec.lat1 = 60.0 * DEG;
+    spec.num_lats = 61;
+    spec.num_lons = 180;
+    return spec;
+}
+
+static void field_itrf(const double lla[3], double dyear, double (*mag)[3]) {
+    double pos[3];
+    geomag_geodetic_to_itrf(lla[0], lla[1], lla[2], &pos);
+    geomag_eval(&WMM2020, dyear, (const double (*)[3]) &pos, mag);
+}
+
+TEST_CASE( "geomag table interpolates the model", "[table]" ) {
+    const geomag_table_spec spec = test_spec();
+    const size_t size = geomag_table_size(&spec);
+    REQUIRE( size > 3 * 6 * 61 * 180 * 24 );
+    std::vector<double> storage(size / sizeof(double) + 1);
+    REQUIRE( geomag_table_build(&WMM2020, &spec, storage.data(), size) == 0 );
+    geomag_table table;
+    REQUIRE( geomag_table_open(storage.data(), size, &WMM2020, &spec, &table) == 0 );
+
+    // Nodes match the model
+    const double node[3] = {-20.0 * DEG, 40.0 * DEG, 300000.0};
+    double mag[3], truth[3];
+    geomag_table_eval(&table, 2022.0, &node, &mag);
+    field_itrf(node, 2022.0, &truth);
+    for (int k = 0; k < 3; ++k) {
+        CHECK( mag[k]*1E9 == Approx(truth[k]*1E9).margin(1e-6) );
+    }
+
+    // Between nodes, up to the interpolation error
+    double lla[4][3] = {
+        {-19.3 * DEG, 41.7 * DEG, 250000.0},
+        {55.5 * DEG, -179.5 * DEG, 10000.0},
+        {0.9 * DEG, 179.9 * DEG, 480000.0},
+        {-59.0 * DEG, 0.5 * DEG, 123456.0}
+    };
+    double dyears[4] = {2020.3, 2021.9, 2023.5, 2024.0};
+    double out[4][3];
+    geomag_table_batch(&table, 4, dyears, lla, out);
+    for (int i = 0; i < 4; ++i) {
+        field_itrf(lla[i], dyears[i], &truth);
+        for (int k = 0; k < 3; ++k) {
+            CHECK( out[i][k]*1E9 == Approx(truth[k]*1E9).margin(100) );
+        }
+    }
+}
+
+TEST_CASE( "geomag table only opens for its model and spec", "[table]" ) {
+    geomag_table_spec spec = test_spec();
+    spec.num_epochs = 2;
+    spec.num_lats = 7;
+    spec.num_lons = 12;
+    const size_t size = geomag_table_size(&spec);
+    std::vector<double> storage(size / sizeof(double) + 1);
+    REQUIRE( geomag_table_build(&WMM2020, &spec, storage.data(), size) == 0 );
+    geomag_table table;
+    CHECK( geomag_table_open(storage.data(), size, &WMM2020, &spec, &table) == 0 );
+    CHECK( geomag_table_open(storage.data(), size, &WMM2020, NULL, &table) == 0 );
+    CHECK( table.spec.num_lons == 12 );
+    CHECK( table.spec.dyear1 == 2024.0 );
+
+    // Truncated
+    CHECK( geomag_table_open(storage.data(), size - 8, &WMM2020, &spec, &table) == -1 );
+    // Another epoch range
+    geomag_table_spec other = spec;
+    other.dyear1 = 2025.0;
+    CHECK( geomag_table_open(storage.data(), size, &WMM2020, &other, &table) == -1 );
+    // Another model
+    static geomag_model model;
+    model = WMM2020;
+    model.coeffs[1].main_field_c += 1.0;
+    CHECK( geomag_table_open(storage.data(), size, &model, &spec, &table) == -1 );
+    // Another layout version
+    unsigned char *bytes = reinterpret_cast<unsigned char *>(storage.data());
+    bytes[8] ^= 0xff;
+    CHECK( geomag_table_open(storage.data(), size, &WMM2020, &spec, &table) == -1 );
+    bytes[8] ^= 0xff;
+    CHECK( geomag_table_open(storage.data(), size, &WMM2020, &spec, &table) == 0 );
+
+    // Invalid specs and short storage
+    other = spec;
+    other.num_lons = 0;
+    CHECK( geomag_table_size(&other) == 0 );
+    CHECK( geomag_table_build(&WMM2020, &other, storage.data(), size) == -1 );
+    CHECK( geomag_table_build(&WMM2020, &spec, storage.data(), size - 1) == -1 );
+}
@@ -0,0 +1,70 @@
+// geomag_taylor_test.cpp Hand-written tests for Taylor expansion reuse
+
+#include "catch.hpp"
+
+#include <cmath>
+
+extern "C" {
+    #include "../geomag_taylor.h"
+}
+
+static void check_trajectory(int order) {
+    const double tol = 0.1e-9;
+    struct geomag_trajectory traj;
+    geomag_trajectory_init(&traj, &WMM2020, order, tol);
+    // 100 Hz samples of a 7.6 km/s orbit at 400 km altitude over 60 s
+    const double r = 6771200.0;
+    const double rate = 7600.0 / r;
+    const int num_samples = 6000;
+    int num_exact = 0;
+    for (int i = 0; i < num_samples; ++i) {
+        const double t = 0.01 * i;
+        const double angle = 0.3 + rate * t;
+        const double pos[3] = {r * std::cos(angle) * 0.8, r * std::sin(angle), r * std::cos(angle) * 0.6};
+        const double dyear = 2022.5 + t / (365.25 * 86400.0);
+        double out[3], truth[3];
+        num_exact += geomag_trajectory_eval(&traj, dyear, &pos, &out);
+        geomag(dyear, &pos, &truth);
+        CHECK( out[0]*1E9 == Approx(truth[0]*1E9).margin(tol*1E9) );
+        CHECK( out[1]*1E9 == Approx(truth[1]*1E9).margin(tol*1E9) );
+        CHECK( out[2]*1E9 == Approx(truth[2]*1E9).margin(tol*1E9) );
+    }
+    CHECK( num_exact == (int) traj.num_exact );
+    CHECK( traj.num_exact + traj.num_predicted == (size_t) num_samples );
+    CHECK( traj.num_exact < (size_t) num_samples / 10 );
+}
+
+TEST_CASE( "geomag trajectory first order predictions meet tolerance", "[taylor]" ) {
+    check_trajectory(1);
+}
+
+TEST_CASE( "geomag trajectory second order predictions meet tolerance", "[taylor]" ) {
+    check_trajectory(2);
+}
+
+TEST_CASE( "geomag cloud predictions meet tolerance and evaluate outliers", "[taylor]" ) {
+    const double tol = 1e-9;
+    const int count = 1000;
+    static double pos[count][3];
+    static double out[count][3];
+    const double mean[3] = {1128529.6885767058, 200000.0, 6358023.736329913};
+    for (int p = 0; p < count; ++p) {
+        // Scattered within a few km, with the last few far out
+        const double spread = (p < count - 5) ? 3000.0 : 200000.0;
+        pos[p][0] = mean[0] + spread * std::sin(1.7 * p);
+        pos[p][1] = mean[1] + spread * std::cos(2.3 * p);
+        pos[p][2] = mean[2] + spread * std::sin(0.9 * p + 1.0);
+    }
+    for (int order = 1; order <= 2; ++order) {
+        const size_t num_exact = geomag_cloud(&WMM2020, 2022.5, count, pos, order, tol, out);
+        CHECK( num_exact >= 6 );
+        CHECK( num_exact < 50 );
+        for (int p = 0; p < count; ++p) {
+            double truth[3];
+            geomag(2022.5, &pos[p], &truth);
+            CHECK( out[p][0]*1E9 == Approx(truth[0]*1E9).margin(tol*1E9) );
+            CHECK( out[p][1]*1E9 == Approx(truth[1]*1E9).margin(tol*1E9) );
+            CHECK( out[p][2]*1E9 == Approx(truth[2]*1E9).margin(tol*1E9) );
+        }
+    }
+}
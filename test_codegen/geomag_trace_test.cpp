@@ -0,0 +1,108 @@
+// geomag_trace_test.cpp Hand-written tests for field line tracing
+
+#include "catch.hpp"
+
+#include <cmath>
+
+extern "C" {
+    #include "../geomag_trace.h"
+}
+
+// 1000 km above 50 N, 10 E on a sphere
+static const double START[3] = {4666133.399559305, 822765.2139272176, 5646666.799118611};
+
+static double norm3(const double v[3]) {
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+TEST_CASE( "geomag trace finds the conjugate point", "[trace]" ) {
+    struct geomag_trace_opts opts;
+    geomag_trace_opts_default(&opts, 2022.5);
+    opts.direction = -1;
+    opts.r_stop = 6371200.0 + 100000.0;
+    static double points[10000][3];
+    struct geomag_trace_result coarse, fine;
+    geomag_trace(&WMM2020, &opts, &START, points, 10000, &coarse);
+    opts.tol = 1e-3;
+    geomag_trace(&WMM2020, &opts, &START, NULL, 0, &fine);
+
+    CHECK( coarse.stop == GEOMAG_TRACE_ALTITUDE );
+    CHECK( fine.stop == GEOMAG_TRACE_ALTITUDE );
+    CHECK( norm3(coarse.pos) == Approx(opts.r_stop).margin(1e-3) );
+    CHECK( coarse.pos[2] < 0 );
+    CHECK( fine.num_steps > coarse.num_steps );
+    CHECK( coarse.length == Approx(fine.length).margin(100.0) );
+    for (int i = 0; i < 3; ++i) {
+        CHECK( coarse.pos[i] == Approx(fine.pos[i]).margin(1000.0) );
+    }
+    REQUIRE( coarse.num_points >= 2 );
+    CHECK( points[0][0] == START[0] );
+    CHECK( points[coarse.num_points - 1][2] == coarse.pos[2] );
+
+    // The line is tangent to the field, so consecutive points are parallel
+    // to the field halfway between them
+    for (size_t p = 1; p < coarse.num_points; ++p) {
+        double mid[3], chord[3], mag[3];
+        for (int i = 0; i < 3; ++i) {
+            mid[i] = 0.5 * (points[p][i] + points[p - 1][i]);
+            chord[i] = points[p][i] - points[p - 1][i];
+        }
+        geomag(2022.5, &mid, &mag);
+        const double dot = -(chord[0] * mag[0] + chord[1] * mag[1] + chord[2] * mag[2]);
+        CHECK( dot / (norm3(chord) * norm3(mag)) == Approx(1.0).margin(1e-3) );
+    }
+}
+
+TEST_CASE( "geomag trace stops at the equator and at the length limit", "[trace]" ) {
+    struct geomag_trace_opts opts;
+    geomag_trace_opts_default(&opts, 2022.5);
+    opts.direction = -1;
+    opts.stop_at_equator = 1;
+    struct geomag_trace_result result;
+    geomag_trace(&WMM2020, &opts, &START, NULL, 0, &result);
+    CHECK( result.stop == GEOMAG_TRACE_EQUATOR );
+    double mag[3];
+    geomag(2022.5, (const double (*)[3]) &result.pos, &mag);
+    const double radial = (mag[0] * result.pos[0] + mag[1] * result.pos[1] + mag[2] * result.pos[2])
+        / (norm3(mag) * norm3(result.pos));
+    CHECK( radial == Approx(0.0).margin(1e-6) );
+
+    opts.stop_at_equator = 0;
+    opts.max_length = 1234567.0;
+    geomag_trace(&WMM2020, &opts, &START, NULL, 0, &result);
+    CHECK( result.stop == GEOMAG_TRACE_LENGTH );
+    CHECK( result.length == Approx(1234567.0).margin(1e-6) );
+}
+
+TEST_CASE( "geomag trace fails where the field can't be evaluated", "[trace]" ) {
+    struct geomag_trace_opts opts;
+    geomag_trace_opts_default(&opts, 2022.5);
+    const double origin[3] = {0.0, 0.0, 0.0};
+    struct geomag_trace_result result;
+    geomag_trace(&WMM2020, &opts, &origin, NULL, 0, &result);
+    CHECK( result.stop == GEOMAG_TRACE_FAILED );
+    CHECK( result.num_steps == 0 );
+    CHECK( std::isinf(result.b_min) );
+    CHECK( result.b_min_length == 0.0 );
+    CHECK( result.b_min_pos[0] == 0.0 );
+}
+
+TEST_CASE( "geomag trace batch matches single traces", "[trace]" ) {
+    struct geomag_trace_opts opts;
+    geomag_trace_opts_default(&opts, 2022.5);
+    opts.direction = -1;
+    double starts[3][3];
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            starts[i][j] = START[j] * (1.0 + 0.1 * i);
+        }
+    }
+    struct geomag_trace_result batch[3], single;
+    geomag_trace_batch(&WMM2020, &opts, 3, starts, batch);
+    for (int i = 0; i < 3; ++i) {
+        geomag_trace(&WMM2020, &opts, &starts[i], NULL, 0, &single);
+        CHECK( batch[i].stop == single.stop );
+        CHECK( batch[i].length == single.length );
+        CHECK( batch[i].pos[0] == single.pos[0] );
+    }
+}
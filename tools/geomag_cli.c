@@ -0,0 +1,749 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// geomag-cli: evaluates files of positions at disk speed.
+//
+// Input records are a decimal year and an ECEF position in ITRF frame [m],
+// either as binary little-endian float64 records `dyear x y z`, which are
+// memory mapped and read in place, or as CSV lines `dyear,x,y,z`. Output
+// records are the field in ITRF frame [T], as binary float64 `bx by bz` or
+// CSV lines.
+//
+// Reading, evaluating and writing run as three stages on their own
+// threads, handing chunks of records along a ring, so I/O overlaps with
+// the batch kernel. Build with -fopenmp to also split each chunk across
+// threads.
+//
+// Usage: geomag-cli [-i binary|csv] [-o binary|csv] [-m model.COF] [input]
+// where the input defaults to stdin for CSV, and output goes to stdout.
+//
+// For inputs larger than memory, `-j jobs -O output` splits a binary input
+// into shards of whole records, processed by up to `jobs` worker processes
+// that each map only their own byte range. Workers write results straight
+// to their place in the binary output file, so it comes out merged and in
+// order, and then mark their shard done in `output.done`. If any shard
+// fails, rerunning with `-r` added processes only the shards not yet done,
+// provided the model and input are unchanged. Sharded output is always
+// binary, so `-o csv` is rejected there.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "geomag_tools.h"
+
+// Records per chunk, and chunks in flight between the stages
+#define CHUNK_RECORDS 65536
+#define NUM_SLOTS 3
+
+// Bytes of CSV read at a time
+#define CSV_READ_SIZE (1 << 20)
+
+// Longest CSV output line
+#define CSV_LINE_MAX 96
+
+// Largest shard, bounding each worker's mapping [records]
+#define SHARD_RECORDS (16 * 1024 * 1024)
+
+// Header of the shard done markers file, followed by a byte per shard.
+// A resumed run must match all of it: the same model, the same input file as
+// far as its size and modification time tell, and the same shard layout.
+static const char SHARD_MAGIC[8] = {'G', 'M', 'S', 'H', 'A', 'R', 'D', '2'};
+struct shard_header {
+    char magic[8];
+    // FNV-1a of the model's epoch and coefficients
+    uint64_t model_hash;
+    uint64_t input_size;
+    int64_t input_mtime_sec;
+    int64_t input_mtime_nsec;
+    uint64_t records;
+    uint64_t shards;
+};
+
+enum format { FORMAT_BINARY, FORMAT_CSV };
+
+enum slot_state { SLOT_EMPTY, SLOT_FILLED, SLOT_COMPUTED };
+
+struct chunk {
+    enum slot_state state;
+    // Records to evaluate, pointing into the mapped file or `records`
+    const real (*in)[4];
+    size_t count;
+    // Last chunk, possibly empty
+    int eof;
+    real (*records)[4];
+    real (*mag)[3];
+};
+
+struct pipeline {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    struct chunk slots[NUM_SLOTS];
+    const struct geomag_model *model;
+    enum format in_format, out_format;
+    // Mapped binary input, or the CSV input stream
+    const unsigned char *map;
+    size_t map_size;
+    FILE *csv;
+    // Set by a stage that fails, the others then drain
+    int failed;
+};
+
+// Waits for a slot to reach a state, returns 0 if the pipeline failed first
+static int wait_slot(struct pipeline *p, struct chunk *slot, const enum slot_state state) {
+    pthread_mutex_lock(&p->lock);
+    while (slot->state != state && !p->failed) {
+        pthread_cond_wait(&p->changed, &p->lock);
+    }
+    const int ok = !p->failed;
+    pthread_mutex_unlock(&p->lock);
+    return ok;
+}
+
+static void set_slot(struct pipeline *p, struct chunk *slot, const enum slot_state state) {
+    pthread_mutex_lock(&p->lock);
+    slot->state = state;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void fail(struct pipeline *p) {
+    pthread_mutex_lock(&p->lock);
+    p->failed = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static const double POW10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Largest mantissa a double holds exactly
+#define EXACT_MANTISSA (((uint64_t) 1) << 53)
+
+// Parses a decimal floating point number, returns the end or NULL.
+//
+// Numbers with at most 15 or so significant digits and a small exponent
+// are an exact integer scaled by an exact power of ten, so one correctly
+// rounded operation gives the same result as strtod. Anything else falls
+// back to strtod, which needs the text to end in a non-numeric character.
+static const char *parse_double(const char *s, const char *end, double *out) {
+    const char *start = s;
+    int negative = 0;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        ++s;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0, any = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; ++s, any = 1) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t) (*s - '0');
+            digits += (mantissa != 0);
+        } else {
+            ++exponent;
+        }
+    }
+    if (s < end && *s == '.') {
+        for (++s; s < end && *s >= '0' && *s <= '9'; ++s, any = 1) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t) (*s - '0');
+                digits += (mantissa != 0);
+                --exponent;
+            }
+        }
+    }
+    if (!any) {
+        return NULL;
+    }
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        ++s;
+        int exp_negative = 0, exp_value = 0, exp_any = 0;
+        if (s < end && (*s == '-' || *s == '+')) {
+            exp_negative = (*s == '-');
+            ++s;
+        }
+        for (; s < end && *s >= '0' && *s <= '9'; ++s, exp_any = 1) {
+            if (exp_value < 10000) {
+                exp_value = exp_value * 10 + (*s - '0');
+            }
+        }
+        if (!exp_any) {
+            return NULL;
+        }
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+    if (digits >= 19 || mantissa > EXACT_MANTISSA || exponent > 22 || exponent < -22) {
+        *out = strtod(start, NULL);
+        return s;
+    }
+    double value = (double) mantissa;
+    if (exponent >= 0) {
+        value *= POW10[exponent];
+    } else {
+        value /= POW10[-exponent];
+    }
+    *out = negative ? -value : value;
+    return s;
+}
+
+// Parses one CSV line of four numbers, returns -1 if malformed
+static int parse_record(const char *line, const char *end, real record[4]) {
+    const char *s = line;
+    for (int i = 0; i < 4; ++i) {
+        while (s < end && (*s == ' ' || *s == '\t')) {
+            ++s;
+        }
+        double value;
+        s = parse_double(s, end, &value);
+        if (s == NULL) {
+            return -1;
+        }
+        record[i] = (real) value;
+        while (s < end && (*s == ' ' || *s == '\t' || *s == '\r')) {
+            ++s;
+        }
+        if (i < 3) {
+            if (s == end || *s != ',') {
+                return -1;
+            }
+            ++s;
+        }
+    }
+    return (s == end) ? 0 : -1;
+}
+
+// Reader stage for CSV, parses lines into chunks
+static int read_csv(struct pipeline *p) {
+    // Unparsed text is text[pos, held), always followed by a NUL for strtod
+    char *text = malloc(2 * CSV_READ_SIZE + 1);
+    if (text == NULL) {
+        fprintf(stderr, "geomag-cli: out of memory\n");
+        return -1;
+    }
+    size_t pos = 0, held = 0, line_number = 0;
+    text[0] = '\0';
+    int eof = 0, status = 0;
+    for (size_t c = 0; !eof && status == 0; ++c) {
+        struct chunk *slot = &p->slots[c % NUM_SLOTS];
+        if (!wait_slot(p, slot, SLOT_EMPTY)) {
+            break;
+        }
+        size_t count = 0;
+        while (count < CHUNK_RECORDS && !eof) {
+            char *line = text + pos;
+            char *newline = memchr(line, '\n', held - pos);
+            if (newline == NULL) {
+                if (!feof(p->csv) && !ferror(p->csv)) {
+                    if (pos == 0 && held == 2 * CSV_READ_SIZE) {
+                        fprintf(stderr, "geomag-cli: line %zu is too long\n", line_number + 1);
+                        status = -1;
+                        break;
+                    }
+                    memmove(text, line, held - pos);
+                    held -= pos;
+                    pos = 0;
+                    held += fread(text + held, 1, 2 * CSV_READ_SIZE - held, p->csv);
+                    text[held] = '\0';
+                    continue;
+                }
+                // A last line without a newline
+                eof = 1;
+                newline = text + held;
+            }
+            pos = (size_t) (newline - text) + !eof;
+            ++line_number;
+            while (line < newline && (*line == ' ' || *line == '\t' || *line == '\r')) {
+                ++line;
+            }
+            if (line == newline || *line == '#') {
+                continue;
+            }
+            if (parse_record(line, newline, slot->records[count]) != 0) {
+                fprintf(stderr, "geomag-cli: malformed record on line %zu\n", line_number);
+                status = -1;
+                break;
+            }
+            ++count;
+        }
+        if (status == 0 && ferror(p->csv)) {
+            fprintf(stderr, "geomag-cli: read error: %s\n", strerror(errno));
+            status = -1;
+        }
+        slot->in = (const real (*)[4]) slot->records;
+        slot->count = count;
+        slot->eof = eof;
+        if (status == 0) {
+            set_slot(p, slot, SLOT_FILLED);
+        }
+    }
+    free(text);
+    return status;
+}
+
+// Reader stage for binary input, hands out views of the mapped file
+static int read_binary(struct pipeline *p) {
+    const size_t total = p->map_size / sizeof(real[4]);
+    size_t start = 0;
+    for (size_t c = 0;; ++c) {
+        struct chunk *slot = &p->slots[c % NUM_SLOTS];
+        if (!wait_slot(p, slot, SLOT_EMPTY)) {
+            break;
+        }
+        slot->in = (const real (*)[4]) (p->map + start * sizeof(real[4]));
+        slot->count = (total - start < CHUNK_RECORDS) ? total - start : CHUNK_RECORDS;
+        start += slot->count;
+        slot->eof = (start == total);
+        set_slot(p, slot, SLOT_FILLED);
+        if (slot->eof) {
+            break;
+        }
+    }
+    return 0;
+}
+
+static void *reader(void *arg) {
+    struct pipeline *p = arg;
+    const int status = (p->in_format == FORMAT_CSV) ? read_csv(p) : read_binary(p);
+    if (status != 0) {
+        fail(p);
+    }
+    return NULL;
+}
+
+// Writer stage
+static void *writer(void *arg) {
+    struct pipeline *p = arg;
+    char *text = (p->out_format == FORMAT_CSV) ? malloc((size_t) CHUNK_RECORDS * CSV_LINE_MAX) : NULL;
+    if (p->out_format == FORMAT_CSV && text == NULL) {
+        fprintf(stderr, "geomag-cli: out of memory\n");
+        fail(p);
+        return NULL;
+    }
+    for (size_t c = 0;; ++c) {
+        struct chunk *slot = &p->slots[c % NUM_SLOTS];
+        if (!wait_slot(p, slot, SLOT_COMPUTED)) {
+            break;
+        }
+        size_t written;
+        size_t size;
+        if (p->out_format == FORMAT_CSV) {
+            size = 0;
+            for (size_t i = 0; i < slot->count; ++i) {
+                size += (size_t) snprintf(
+                    text + size, CSV_LINE_MAX, "%.9e,%.9e,%.9e\n",
+                    (double) slot->mag[i][0], (double) slot->mag[i][1], (double) slot->mag[i][2]
+                );
+            }
+            written = fwrite(text, 1, size, stdout);
+        } else {
+            size = slot->count * sizeof(real[3]);
+            written = fwrite(slot->mag, 1, size, stdout);
+        }
+        if (written != size) {
+            fprintf(stderr, "geomag-cli: write error: %s\n", strerror(errno));
+            fail(p);
+            break;
+        }
+        const int eof = slot->eof;
+        set_slot(p, slot, SLOT_EMPTY);
+        if (eof) {
+            break;
+        }
+    }
+    free(text);
+    return NULL;
+}
+
+// Evaluation stage, run on the calling thread
+static void evaluate(struct pipeline *p) {
+    for (size_t c = 0;; ++c) {
+        struct chunk *slot = &p->slots[c % NUM_SLOTS];
+        if (!wait_slot(p, slot, SLOT_FILLED)) {
+            break;
+        }
+        // Records are read in place, so only the strides describe them
+        geomag_batch_strided(
+            p->model, slot->count, &slot->in[0][0], sizeof(real[4]), &slot->in[0][1], sizeof(real[4]),
+            GEOMAG_FRAME_ITRF, NULL, 0, &slot->mag[0][0], sizeof(real[3])
+        );
+        const int eof = slot->eof;
+        set_slot(p, slot, SLOT_COMPUTED);
+        if (eof) {
+            break;
+        }
+    }
+}
+
+static int parse_format(const char *name, enum format *format) {
+    if (strcmp(name, "binary") == 0) {
+        *format = FORMAT_BINARY;
+    } else if (strcmp(name, "csv") == 0) {
+        *format = FORMAT_CSV;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Writes all of a buffer at an offset, returns -1 on error
+static int pwrite_all(const int fd, const void *buf, size_t size, off_t offset) {
+    const char *bytes = buf;
+    while (size > 0) {
+        const ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        bytes += written;
+        size -= (size_t) written;
+        offset += written;
+    }
+    return 0;
+}
+
+// Worker process for one shard, returns the exit status
+static int run_shard(
+    const struct geomag_model *model, const int in_fd, const int out_fd, const int done_fd,
+    const uint64_t shard, const uint64_t first, const uint64_t count
+) {
+    // Map just this shard, from the page containing its first record
+    const off_t page = (off_t) sysconf(_SC_PAGESIZE);
+    const off_t start = (off_t) (first * sizeof(real[4]));
+    const off_t map_start = start - start % page;
+    const size_t map_size = (size_t) (start - map_start) + count * sizeof(real[4]);
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, in_fd, map_start);
+    real (*mag)[3] = malloc(CHUNK_RECORDS * sizeof(real[3]));
+    if (map == MAP_FAILED || mag == NULL) {
+        fprintf(stderr, "geomag-cli: shard %llu: %s\n", (unsigned long long) shard, strerror(errno));
+        return 1;
+    }
+    posix_madvise(map, map_size, POSIX_MADV_SEQUENTIAL);
+    const real (*records)[4] = (const real (*)[4]) ((const char *) map + (start - map_start));
+
+    int status = 0;
+    for (uint64_t done = 0; done < count && status == 0; done += CHUNK_RECORDS) {
+        const size_t n = (size_t) ((count - done < CHUNK_RECORDS) ? count - done : CHUNK_RECORDS);
+        const real (*in)[4] = records + done;
+        geomag_batch_strided(
+            model, n, &in[0][0], sizeof(real[4]), &in[0][1], sizeof(real[4]), GEOMAG_FRAME_ITRF, NULL, 0,
+            &mag[0][0], sizeof(real[3])
+        );
+        const off_t offset = (off_t) ((first + done) * sizeof(real[3]));
+        status = pwrite_all(out_fd, mag, n * sizeof(real[3]), offset);
+    }
+    // Results must be on disk before the shard is marked done
+    const char one = 1;
+    if (status == 0) {
+        status = fdatasync(out_fd);
+    }
+    if (status == 0) {
+        status = pwrite_all(done_fd, &one, 1, (off_t) (sizeof(struct shard_header) + shard));
+    }
+    if (status == 0) {
+        status = fdatasync(done_fd);
+    }
+    if (status != 0) {
+        fprintf(stderr, "geomag-cli: shard %llu: %s\n", (unsigned long long) shard, strerror(errno));
+    }
+    free(mag);
+    munmap(map, map_size);
+    return status != 0;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *bytes, const size_t size) {
+    const unsigned char *p = bytes;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ p[i]) * 0x100000001b3u;
+    }
+    return hash;
+}
+
+static uint64_t model_hash(const struct geomag_model *model) {
+    const uint64_t hash = hash_bytes(0xcbf29ce484222325u, &model->epoch, sizeof(model->epoch));
+    return hash_bytes(hash, model->coeffs, sizeof(model->coeffs));
+}
+
+// Processes a binary input in shards across worker processes
+static int run_sharded(
+    const struct geomag_model *model, const char *path, const char *out_path, const int jobs, const int resume
+) {
+    struct stat st;
+    const int in_fd = open(path, O_RDONLY);
+    if (in_fd < 0 || fstat(in_fd, &st) != 0 || st.st_size % (off_t) sizeof(real[4]) != 0) {
+        fprintf(stderr, "geomag-cli: cannot use %s as binary input\n", path);
+        return 1;
+    }
+    const uint64_t records = (uint64_t) st.st_size / sizeof(real[4]);
+    // At least a shard per job, so every core has work
+    uint64_t shards = (records + SHARD_RECORDS - 1) / SHARD_RECORDS;
+    if (shards < (uint64_t) jobs) {
+        shards = (records < (uint64_t) jobs) ? records : (uint64_t) jobs;
+    }
+    const uint64_t per_shard = (shards > 0) ? (records + shards - 1) / shards : 0;
+    shards = (per_shard > 0) ? (records + per_shard - 1) / per_shard : 0;
+
+    char done_path[4096];
+    if (snprintf(done_path, sizeof(done_path), "%s.done", out_path) >= (int) sizeof(done_path)) {
+        fprintf(stderr, "geomag-cli: output path is too long\n");
+        return 1;
+    }
+    const int flags = O_RDWR | O_CREAT | (resume ? 0 : O_TRUNC);
+    const int out_fd = open(out_path, flags, 0644);
+    const int done_fd = open(done_path, flags, 0644);
+    if (out_fd < 0 || done_fd < 0) {
+        fprintf(stderr, "geomag-cli: cannot open %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+
+    // A resumed run must have the same header, otherwise start over
+    unsigned char *done = calloc((size_t) shards + 1, 1);
+    struct shard_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SHARD_MAGIC, sizeof(SHARD_MAGIC));
+    header.model_hash = model_hash(model);
+    header.input_size = (uint64_t) st.st_size;
+    header.input_mtime_sec = (int64_t) st.st_mtim.tv_sec;
+    header.input_mtime_nsec = (int64_t) st.st_mtim.tv_nsec;
+    header.records = records;
+    header.shards = shards;
+    struct shard_header existing;
+    const int matches = resume
+        && pread(done_fd, &existing, sizeof(existing), 0) == (ssize_t) sizeof(existing)
+        && memcmp(&existing, &header, sizeof(header)) == 0;
+    if (done == NULL) {
+        fprintf(stderr, "geomag-cli: out of memory\n");
+        return 1;
+    }
+    if (matches) {
+        if (pread(done_fd, done, (size_t) shards, sizeof(header)) < 0) {
+            memset(done, 0, (size_t) shards);
+        }
+    } else if (
+        ftruncate(done_fd, 0) != 0 || pwrite_all(done_fd, &header, sizeof(header), 0) != 0
+        || pwrite_all(done_fd, done, (size_t) shards, sizeof(header)) != 0
+        || ftruncate(out_fd, (off_t) (records * sizeof(real[3]))) != 0 || fdatasync(done_fd) != 0
+    ) {
+        fprintf(stderr, "geomag-cli: cannot prepare %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+
+    int running = 0, failed = 0;
+    for (uint64_t s = 0; s <= shards; ++s) {
+        // Reap a worker when all slots are busy, and all of them at the end
+        while (running > 0 && (running >= jobs || s == shards)) {
+            int status;
+            if (wait(&status) < 0) {
+                break;
+            }
+            --running;
+            failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+        if (s == shards || done[s] == 1) {
+            continue;
+        }
+        const uint64_t first = s * per_shard;
+        const uint64_t count = (records - first < per_shard) ? records - first : per_shard;
+        fflush(stderr);
+        const pid_t pid = fork();
+        if (pid == 0) {
+            _exit(run_shard(model, in_fd, out_fd, done_fd, s, first, count));
+        } else if (pid < 0) {
+            fprintf(stderr, "geomag-cli: cannot start worker: %s\n", strerror(errno));
+            ++failed;
+        } else {
+            ++running;
+        }
+    }
+    free(done);
+    close(in_fd);
+    close(out_fd);
+    close(done_fd);
+    if (failed > 0) {
+        fprintf(stderr, "geomag-cli: %d shards failed, rerun with -r to resume\n", failed);
+        return 1;
+    }
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(
+        stderr,
+        "usage: geomag-cli [-i binary|csv] [-o binary|csv] [-m model.COF] [input]\n"
+        "       geomag-cli -i binary -j jobs -O output [-r] [-m model.COF] input\n"
+    );
+}
+
+int main(int argc, char **argv) {
+    static struct geomag_model loaded;
+    struct pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.model = &WMM2020;
+    p.in_format = FORMAT_CSV;
+    p.out_format = FORMAT_CSV;
+
+    const char *out_path = NULL;
+    int jobs = 0, resume = 0, out_given = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:m:j:O:rh")) != -1) {
+        switch (opt) {
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'O':
+            out_path = optarg;
+            break;
+        case 'r':
+            resume = 1;
+            break;
+        case 'i':
+        case 'o':
+            if (parse_format(optarg, (opt == 'i') ? &p.in_format : &p.out_format) != 0) {
+                usage();
+                return 2;
+            }
+            out_given |= (opt == 'o');
+            break;
+        case 'm':
+            if (load_model(optarg, &loaded) != 0) {
+                fprintf(stderr, "geomag-cli: cannot load model %s\n", optarg);
+                return 1;
+            }
+            p.model = &loaded;
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    const char *path = (optind < argc) ? argv[optind] : NULL;
+    if (optind + 1 < argc || (p.in_format == FORMAT_BINARY && path == NULL)) {
+        usage();
+        return 2;
+    }
+    // Only binary records, including every sharded run, are raw doubles
+    const int sharded = (jobs > 0 || out_path != NULL || resume);
+    const int binary = sharded || p.in_format == FORMAT_BINARY || p.out_format == FORMAT_BINARY;
+    const uint16_t probe = 1;
+    if (binary && (sizeof(real) != sizeof(double) || *(const unsigned char *) &probe != 1)) {
+        fprintf(stderr, "geomag-cli: binary records need a little-endian host with double reals\n");
+        return 1;
+    }
+    if (sharded) {
+        // Shards need fixed size records on both sides
+        if (jobs <= 0 || out_path == NULL || path == NULL || p.in_format != FORMAT_BINARY
+            || (out_given && p.out_format != FORMAT_BINARY)) {
+            usage();
+            return 2;
+        }
+        return run_sharded(p.model, path, out_path, jobs, resume);
+    }
+
+    int fd = -1;
+    if (p.in_format == FORMAT_BINARY) {
+        struct stat st;
+        fd = open(path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            fprintf(stderr, "geomag-cli: cannot open %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+        p.map_size = (size_t) st.st_size;
+        if (p.map_size % sizeof(real[4]) != 0) {
+            fprintf(stderr, "geomag-cli: %s is not a whole number of records\n", path);
+            close(fd);
+            return 1;
+        }
+        if (p.map_size > 0) {
+            void *map = mmap(NULL, p.map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                fprintf(stderr, "geomag-cli: cannot map %s: %s\n", path, strerror(errno));
+                close(fd);
+                return 1;
+            }
+            posix_madvise(map, p.map_size, POSIX_MADV_SEQUENTIAL);
+            p.map = map;
+        }
+    } else {
+        p.csv = (path == NULL || strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+        if (p.csv == NULL) {
+            fprintf(stderr, "geomag-cli: cannot open %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+    }
+
+    int status = 0;
+    for (int i = 0; i < NUM_SLOTS; ++i) {
+        p.slots[i].state = SLOT_EMPTY;
+        p.slots[i].records = (p.in_format == FORMAT_CSV) ? malloc(CHUNK_RECORDS * sizeof(real[4])) : NULL;
+        p.slots[i].mag = malloc(CHUNK_RECORDS * sizeof(real[3]));
+        if ((p.in_format == FORMAT_CSV && p.slots[i].records == NULL) || p.slots[i].mag == NULL) {
+            status = 1;
+        }
+    }
+    pthread_t read_thread, write_thread;
+    if (status == 0) {
+        pthread_mutex_init(&p.lock, NULL);
+        pthread_cond_init(&p.changed, NULL);
+        pthread_create(&read_thread, NULL, reader, &p);
+        pthread_create(&write_thread, NULL, writer, &p);
+        evaluate(&p);
+        pthread_join(read_thread, NULL);
+        pthread_join(write_thread, NULL);
+        pthread_cond_destroy(&p.changed);
+        pthread_mutex_destroy(&p.lock);
+        status = p.failed || fflush(stdout) != 0;
+    } else {
+        fprintf(stderr, "geomag-cli: out of memory\n");
+    }
+
+    for (int i = 0; i < NUM_SLOTS; ++i) {
+        free(p.slots[i].records);
+        free(p.slots[i].mag);
+    }
+    if (p.map != NULL) {
+        munmap((void *) p.map, p.map_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (p.csv != NULL && p.csv != stdin) {
+        fclose(p.csv);
+    }
+    return status;
+}
@@ -0,0 +1,179 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// geomag-control: runs a simulated control loop against the offload queue.
+//
+// A control thread ticks at a fixed rate on an absolute schedule. Each tick
+// it takes the newest finished field from a `geomag_async` queue and posts
+// the next position of a circular orbit, never waiting on the worker. The
+// worker runs `geomag_async_run` on a thread of its own, pinned to a core
+// on Linux. At the end the queue statistics are reported: overflows,
+// skipped results, the age of the fields used and what the queue calls
+// cost the control thread.
+//
+// Usage: geomag-control [-r rate_hz] [-s seconds] [-c capacity] [-p cpu]
+// where the run must last at least one tick.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../geomag_async.h"
+
+static double seconds(const struct timespec *t) {
+    return (double) t->tv_sec + 1e-9 * (double) t->tv_nsec;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return seconds(&t);
+}
+
+static void *worker(void *arg) {
+    geomag_async_run(arg);
+    return NULL;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: geomag-control [-r rate_hz] [-s seconds] [-c capacity] [-p cpu]\n");
+}
+
+int main(int argc, char **argv) {
+    double rate = 1000, duration = 1;
+    size_t capacity = 4;
+    int cpu = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:c:p:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 's':
+            duration = atof(optarg);
+            break;
+        case 'c':
+            capacity = (size_t) atol(optarg);
+            break;
+        case 'p':
+            cpu = atoi(optarg);
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    // At least one tick, so there is something to report
+    if (optind != argc || !(rate > 0) || !(duration > 0) || !(rate * duration >= 1)) {
+        usage();
+        return 2;
+    }
+    struct geomag_async *queue = geomag_async_new(&WMM2020, capacity);
+    if (queue == NULL) {
+        fprintf(stderr, "geomag-control: cannot create a queue of %zu\n", capacity);
+        return 1;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker, queue) != 0) {
+        fprintf(stderr, "geomag-control: cannot start the worker\n");
+        geomag_async_free(queue);
+        return 1;
+    }
+    if (cpu >= 0) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        const int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+        if (err != 0) {
+            fprintf(stderr, "geomag-control: cannot pin the worker to cpu %d: %s\n", cpu, strerror(err));
+        }
+#else
+        fprintf(stderr, "geomag-control: pinning is only supported on Linux\n");
+#endif
+    }
+
+    // 7000 km circular polar orbit, about 97 minutes round
+    const double radius = 7e6, omega = 2 * 3.14159265358979323846 / 5828.5;
+    const long ticks = (long) (rate * duration);
+    const long period_ns = (long) (1e9 / rate);
+    long stale = 0;
+    double call_max = 0, call_sum = 0;
+    struct geomag_async_result result;
+    int have_result = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    const double start = seconds(&next);
+    for (long tick = 0; tick < ticks; ++tick) {
+        next.tv_nsec += period_ns;
+        next.tv_sec += next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+
+        const double t = now();
+        const double angle = omega * (t - start);
+        const real pos[3] = {radius * cos(angle), 0, radius * sin(angle)};
+        const double before = now();
+        have_result |= geomag_async_latest(queue, t, &result);
+        geomag_async_post(queue, t, 2022.5 + (t - start) / 31557600, &pos);
+        const double call = now() - before;
+        call_max = (call > call_max) ? call : call_max;
+        call_sum += call;
+        // The control law would use `result.mag_itrf` here
+        stale += !have_result;
+    }
+    geomag_async_stop(queue);
+    pthread_join(thread, NULL);
+
+    struct geomag_async_stats stats;
+    geomag_async_get_stats(queue, &stats);
+    geomag_async_free(queue);
+    printf("%ld ticks at %.0f Hz, %ld before the first result\n", ticks, rate, stale);
+    printf(
+        "posted %llu, overflows %llu, collected %llu, skipped %llu\n", (unsigned long long) stats.posted,
+        (unsigned long long) stats.overflows, (unsigned long long) stats.collected,
+        (unsigned long long) stats.skipped
+    );
+    if (stats.collected > 0) {
+        printf(
+            "field age: mean %.1f us, p50 < %.1f us, p99 < %.1f us, max %.1f us\n",
+            1e6 * stats.latency_sum / (double) stats.collected, 1e6 * geomag_async_percentile(&stats, 0.5),
+            1e6 * geomag_async_percentile(&stats, 0.99), 1e6 * stats.latency_max
+        );
+    }
+    printf(
+        "control thread queue calls: mean %.2f us, max %.2f us\n", 1e6 * call_sum / (double) ticks, 1e6 * call_max
+    );
+    return 0;
+}
@@ -0,0 +1,552 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// geomag-daemon: evaluates requests from local processes in shared batches.
+//
+// Clients send small requests over a Unix domain socket, with records and
+// results passed in shared memory as described in geomag_daemon.h. The
+// main thread serves the socket and queues requests, while an evaluation
+// thread coalesces queued requests into one batch. A batch is started once
+// the oldest request has waited the latency window, or sooner once it holds
+// the batch size. While a batch is evaluated new requests keep queueing, so
+// under load batches grow without waiting. Build with -fopenmp to also
+// split each batch across threads.
+//
+// Usage: geomag-daemon [-w window_us] [-b batch] [-m model.COF] socket
+//
+// On SIGHUP the model file is read again and published without stopping,
+// so a new model release is picked up in place. Batches already started
+// finish on the old model, and later ones use the new one.
+//
+// The socket is created readable only by its owner. Clients are trusted
+// not to shrink their shared buffer while a request is outstanding.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../geomag.h"
+#include "../geomag_swap.h"
+#include "geomag_daemon.h"
+#include "geomag_tools.h"
+
+// Pending connections on the listening socket
+#define LISTEN_BACKLOG 64
+
+struct client {
+    int fd;
+    // Shared buffer, mapped once the hello arrives
+    real (*in)[4];
+    real (*out)[3];
+    size_t capacity;
+    // Outstanding request, owned by the evaluation thread while busy
+    size_t count;
+    struct timespec arrival;
+    int busy;
+    // Hung up while busy, freed by the evaluation thread once answered
+    int closing;
+    struct client *next;
+};
+
+struct daemon {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    // Queued requests, oldest first, and their total records
+    struct client *head;
+    struct client **tail;
+    size_t pending;
+    // Published model, read by the evaluation thread without locking
+    struct geomag_model_slot *models;
+    const char *model_path;
+    long window_ns;
+    size_t batch;
+    // Gathered records and results of a batch
+    real (*in)[4];
+    real (*out)[3];
+    int stop;
+    // Statistics, reported on exit
+    uint64_t requests, batches, records;
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t reload_requested = 0;
+
+static void on_signal(const int sig) {
+    if (sig == SIGHUP) {
+        reload_requested = 1;
+    } else {
+        stop_requested = 1;
+    }
+}
+
+static void free_client(struct client *c) {
+    if (c->in != NULL) {
+        munmap(c->in, GEOMAG_DAEMON_BUFFER_SIZE(c->capacity));
+    }
+    close(c->fd);
+    free(c);
+}
+
+static int reply(struct client *c, const int64_t status) {
+    const struct geomag_daemon_reply message = {status};
+    const ssize_t sent = send(c->fd, &message, sizeof(message), MSG_NOSIGNAL | MSG_DONTWAIT);
+    return (sent == (ssize_t) sizeof(message)) ? 0 : -1;
+}
+
+// Whether `a` is at or after `b`
+static int time_reached(const struct timespec *a, const struct timespec *b) {
+    return a->tv_sec > b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec >= b->tv_nsec);
+}
+
+// Evaluates a batch of requests taken off the queue
+static void evaluate(struct daemon *d, struct client *batch, const size_t records) {
+    struct geomag_model_hold hold;
+    geomag_model_acquire(d->models, &hold);
+    if (batch->next == NULL) {
+        // A lone request is evaluated in place
+        geomag_batch_strided(
+            hold.model, batch->count, &batch->in[0][0], sizeof(real[4]), &batch->in[0][1], sizeof(real[4]),
+            GEOMAG_FRAME_ITRF, NULL, 0, &batch->out[0][0], sizeof(real[3])
+        );
+    } else {
+        size_t start = 0;
+        for (struct client *c = batch; c != NULL; c = c->next) {
+            memcpy(d->in[start], c->in, c->count * sizeof(real[4]));
+            start += c->count;
+        }
+        geomag_batch_strided(
+            hold.model, records, &d->in[0][0], sizeof(real[4]), &d->in[0][1], sizeof(real[4]),
+            GEOMAG_FRAME_ITRF, NULL, 0, &d->out[0][0], sizeof(real[3])
+        );
+        start = 0;
+        for (struct client *c = batch; c != NULL; c = c->next) {
+            memcpy(c->out, d->out[start], c->count * sizeof(real[3]));
+            start += c->count;
+        }
+    }
+    geomag_model_release(d->models, &hold);
+}
+
+// Evaluation thread, coalesces queued requests into batches
+static void *evaluator(void *arg) {
+    struct daemon *d = arg;
+    pthread_mutex_lock(&d->lock);
+    while (!d->stop) {
+        if (d->head == NULL) {
+            pthread_cond_wait(&d->changed, &d->lock);
+            continue;
+        }
+        struct timespec now, deadline = d->head->arrival;
+        deadline.tv_nsec += d->window_ns;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (d->pending < d->batch && !time_reached(&now, &deadline)) {
+            pthread_cond_timedwait(&d->changed, &d->lock, &deadline);
+            continue;
+        }
+        // Take whole requests up to the batch size, and always the first
+        struct client *batch = d->head, **end = &d->head->next;
+        size_t records = batch->count;
+        while (*end != NULL && records + (*end)->count <= d->batch) {
+            records += (*end)->count;
+            end = &(*end)->next;
+        }
+        d->head = *end;
+        *end = NULL;
+        if (d->head == NULL) {
+            d->tail = &d->head;
+        }
+        d->pending -= records;
+        pthread_mutex_unlock(&d->lock);
+
+        evaluate(d, batch, records);
+
+        // Answered under the lock, so a client's next request finds it idle
+        pthread_mutex_lock(&d->lock);
+        d->records += records;
+        ++d->batches;
+        while (batch != NULL) {
+            struct client *c = batch;
+            batch = c->next;
+            c->next = NULL;
+            c->busy = 0;
+            if (c->closing) {
+                free_client(c);
+            } else {
+                reply(c, 0);
+            }
+            ++d->requests;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+// Stops serving a client, handing it to the evaluation thread if busy
+static void drop_client(struct daemon *d, struct client *c) {
+    pthread_mutex_lock(&d->lock);
+    const int busy = c->busy;
+    c->closing = 1;
+    pthread_mutex_unlock(&d->lock);
+    if (!busy) {
+        free_client(c);
+    }
+}
+
+// Maps the shared buffer passed with a hello
+static int accept_hello(struct client *c, const struct geomag_daemon_hello *hello, const int buffer_fd) {
+    struct stat st;
+    if (hello->magic != GEOMAG_DAEMON_MAGIC || hello->capacity == 0 || buffer_fd < 0
+        || hello->capacity > SIZE_MAX / (7 * sizeof(double)) || fstat(buffer_fd, &st) != 0
+        || (uint64_t) st.st_size < GEOMAG_DAEMON_BUFFER_SIZE(hello->capacity)) {
+        return -1;
+    }
+    const size_t capacity = (size_t) hello->capacity;
+    void *map = mmap(
+        NULL, GEOMAG_DAEMON_BUFFER_SIZE(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, buffer_fd, 0
+    );
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    c->in = map;
+    c->out = (real (*)[3]) (c->in + capacity);
+    c->capacity = capacity;
+    return 0;
+}
+
+// Handles a message from a client, returns -1 to drop it
+static int serve(struct daemon *d, struct client *c) {
+    union {
+        struct geomag_daemon_hello hello;
+        struct geomag_daemon_request request;
+    } message;
+    union {
+        struct cmsghdr align;
+        char bytes[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = {&message, sizeof(message)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.bytes;
+    msg.msg_controllen = sizeof(control.bytes);
+    const ssize_t size = recvmsg(c->fd, &msg, 0);
+    if (size <= 0) {
+        return (size < 0 && errno == EINTR) ? 0 : -1;
+    }
+    int buffer_fd = -1;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+            && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+            memcpy(&buffer_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
+    if (c->in == NULL) {
+        const int status = (size == sizeof(message.hello) && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+            ? accept_hello(c, &message.hello, buffer_fd) : -1;
+        if (buffer_fd >= 0) {
+            close(buffer_fd);
+        }
+        return (reply(c, status) == 0 && status == 0) ? 0 : -1;
+    }
+    if (buffer_fd >= 0) {
+        close(buffer_fd);
+    }
+    pthread_mutex_lock(&d->lock);
+    const int busy = c->busy;
+    pthread_mutex_unlock(&d->lock);
+    if (busy) {
+        // Only one request may be outstanding
+        return -1;
+    }
+    if (size != sizeof(message.request) || message.request.count > c->capacity) {
+        return reply(c, -1);
+    }
+    if (message.request.count == 0) {
+        return reply(c, 0);
+    }
+    c->count = (size_t) message.request.count;
+    clock_gettime(CLOCK_MONOTONIC, &c->arrival);
+    pthread_mutex_lock(&d->lock);
+    c->busy = 1;
+    *d->tail = c;
+    d->tail = &c->next;
+    d->pending += c->count;
+    pthread_cond_signal(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+// Reads the model file again and publishes it
+static void reload(struct daemon *d) {
+    if (d->model_path == NULL) {
+        fprintf(stderr, "geomag-daemon: no model file to reload\n");
+        return;
+    }
+    struct geomag_model *model = malloc(sizeof(struct geomag_model));
+    if (model == NULL || load_model(d->model_path, model) != 0) {
+        fprintf(stderr, "geomag-daemon: cannot load model %s, keeping the current one\n", d->model_path);
+        free(model);
+        return;
+    }
+    // Waits out the batch in progress, if any, which still uses the old model
+    const struct geomag_model *old = geomag_model_publish(d->models, model);
+    if (old != &WMM2020) {
+        free((void *) old);
+    }
+    fprintf(stderr, "geomag-daemon: reloaded model %s, epoch %.1f\n", d->model_path, (double) model->epoch);
+}
+
+// Serves the socket until a signal asks to stop
+static int run(struct daemon *d, const int listen_fd) {
+    struct client **clients = NULL;
+    struct pollfd *fds = NULL;
+    size_t num_clients = 0, max_clients = 0;
+    int status = 0;
+    while (!stop_requested) {
+        if (reload_requested) {
+            reload_requested = 0;
+            reload(d);
+        }
+        if (max_clients < num_clients + 1) {
+            max_clients = 2 * (num_clients + 1);
+            struct client **new_clients = realloc(clients, max_clients * sizeof(*clients));
+            if (new_clients != NULL) {
+                clients = new_clients;
+            }
+            struct pollfd *new_fds = realloc(fds, (max_clients + 1) * sizeof(*fds));
+            if (new_fds != NULL) {
+                fds = new_fds;
+            }
+            if (new_clients == NULL || new_fds == NULL) {
+                fprintf(stderr, "geomag-daemon: out of memory\n");
+                status = 1;
+                break;
+            }
+        }
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < num_clients; ++i) {
+            fds[i + 1].fd = clients[i]->fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(fds, num_clients + 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "geomag-daemon: poll failed: %s\n", strerror(errno));
+            status = 1;
+            break;
+        }
+        // Serve existing clients first, as accepting may grow the list
+        size_t kept = 0;
+        for (size_t i = 0; i < num_clients; ++i) {
+            struct client *c = clients[i];
+            if ((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) && serve(d, c) != 0) {
+                drop_client(d, c);
+            } else {
+                clients[kept++] = c;
+            }
+        }
+        num_clients = kept;
+        if (fds[0].revents & POLLIN) {
+            const int fd = accept(listen_fd, NULL, NULL);
+            struct client *c = (fd >= 0) ? calloc(1, sizeof(*c)) : NULL;
+            if (c != NULL) {
+                c->fd = fd;
+                clients[num_clients++] = c;
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+    for (size_t i = 0; i < num_clients; ++i) {
+        drop_client(d, clients[i]);
+    }
+    free(clients);
+    free(fds);
+    return status;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: geomag-daemon [-w window_us] [-b batch] [-m model.COF] socket\n");
+}
+
+int main(int argc, char **argv) {
+    struct daemon d;
+    memset(&d, 0, sizeof(d));
+    d.tail = &d.head;
+    d.window_ns = 200000;
+    d.batch = 65536;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:b:m:h")) != -1) {
+        switch (opt) {
+        case 'w':
+            d.window_ns = 1000 * atol(optarg);
+            break;
+        case 'b':
+            d.batch = (size_t) atol(optarg);
+            break;
+        case 'm':
+            d.model_path = optarg;
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (optind + 1 != argc || d.window_ns < 0 || d.window_ns >= 1000000000 || d.batch == 0) {
+        usage();
+        return 2;
+    }
+    const char *path = argv[optind];
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "geomag-daemon: socket path is too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    if (sizeof(real) != sizeof(double)) {
+        fprintf(stderr, "geomag-daemon: shared buffers need double reals\n");
+        return 1;
+    }
+
+    struct geomag_model *loaded = NULL;
+    if (d.model_path != NULL) {
+        loaded = malloc(sizeof(struct geomag_model));
+        if (loaded == NULL || load_model(d.model_path, loaded) != 0) {
+            fprintf(stderr, "geomag-daemon: cannot load model %s\n", d.model_path);
+            free(loaded);
+            return 1;
+        }
+    }
+    d.models = geomag_model_slot_new((loaded != NULL) ? loaded : &WMM2020);
+    d.in = malloc(d.batch * sizeof(real[4]));
+    d.out = malloc(d.batch * sizeof(real[3]));
+    if (d.models == NULL || d.in == NULL || d.out == NULL) {
+        fprintf(stderr, "geomag-daemon: out of memory\n");
+        if (d.models != NULL) {
+            geomag_model_slot_free(d.models);
+        }
+        free(loaded);
+        free(d.in);
+        free(d.out);
+        return 1;
+    }
+    const int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    const mode_t mask = umask(077);
+    const int bound = (listen_fd >= 0) ? bind(listen_fd, (const struct sockaddr *) &addr, sizeof(addr)) : -1;
+    umask(mask);
+    if (bound != 0 || listen(listen_fd, LISTEN_BACKLOG) != 0) {
+        fprintf(stderr, "geomag-daemon: cannot listen on %s: %s\n", path, strerror(errno));
+        if (bound == 0) {
+            unlink(path);
+        }
+        if (listen_fd >= 0) {
+            close(listen_fd);
+        }
+        geomag_model_slot_free(d.models);
+        free(loaded);
+        free(d.in);
+        free(d.out);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGHUP, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&d.lock, NULL);
+    pthread_cond_init(&d.changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    // Signals go to the serving thread, interrupting its poll
+    sigset_t signals, old_signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, &old_signals);
+    pthread_t thread;
+    pthread_create(&thread, NULL, evaluator, &d);
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+    const int status = run(&d, listen_fd);
+
+    pthread_mutex_lock(&d.lock);
+    d.stop = 1;
+    pthread_cond_broadcast(&d.changed);
+    pthread_mutex_unlock(&d.lock);
+    pthread_join(thread, NULL);
+    // Requests still queued are never answered
+    while (d.head != NULL) {
+        struct client *c = d.head;
+        d.head = c->next;
+        free_client(c);
+    }
+    pthread_cond_destroy(&d.changed);
+    pthread_mutex_destroy(&d.lock);
+    close(listen_fd);
+    unlink(path);
+    const struct geomag_model *model = geomag_model_publish(d.models, &WMM2020);
+    if (model != &WMM2020) {
+        free((void *) model);
+    }
+    geomag_model_slot_free(d.models);
+    free(d.in);
+    free(d.out);
+    fprintf(
+        stderr, "geomag-daemon: %llu requests of %llu records in %llu batches\n",
+        (unsigned long long) d.requests, (unsigned long long) d.records, (unsigned long long) d.batches
+    );
+    return status;
+}
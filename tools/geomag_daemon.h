@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Protocol between geomag-daemon and its clients.
+//
+// Clients connect to the daemon's Unix domain socket, of type
+// SOCK_SEQPACKET so every message arrives whole. The first message is a
+// `geomag_daemon_hello` carrying, as SCM_RIGHTS ancillary data, the file
+// descriptor of a shared memory buffer the client made with `shm_open`.
+// The buffer holds `capacity` input records `dyear x y z` followed by
+// `capacity` output vectors `bx by bz`, all as native doubles, with
+// positions in ITRF frame [m] and the field in ITRF frame [T].
+//
+// After the hello is answered, each `geomag_daemon_request` asks for the
+// first `count` records of the buffer to be evaluated. The reply comes once
+// the outputs are written to the buffer. A connection has at most one
+// request outstanding, so a client with several threads opens a connection
+// per thread.
+
+#ifndef GEOMAG_DAEMON_H
+#define GEOMAG_DAEMON_H
+
+#include <stdint.h>
+
+// "GMD1", the first field of a hello
+#define GEOMAG_DAEMON_MAGIC 0x474d4431u
+
+// Bytes of shared memory for a buffer of `capacity` records
+#define GEOMAG_DAEMON_BUFFER_SIZE(capacity) ((size_t) (capacity) * 7 * sizeof(double))
+
+struct geomag_daemon_hello {
+    uint32_t magic;
+    uint32_t reserved;
+    // Records the shared buffer holds
+    uint64_t capacity;
+};
+
+struct geomag_daemon_request {
+    // Records to evaluate, at most the capacity
+    uint64_t count;
+};
+
+// Answers both hellos and requests
+struct geomag_daemon_reply {
+    // 0 on success, -1 if the message was rejected
+    int64_t status;
+};
+
+#endif // GEOMAG_DAEMON_H
@@ -0,0 +1,274 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// geomag-grid-mpi: generates volumetric field grids across MPI processes.
+//
+// The grid is uniform in WGS 84 geodetic latitude, longitude and height.
+// It is decomposed into tiles of a latitude band by an altitude shell,
+// each spanning every longitude. Tiles are dealt round robin to ranks, which
+// synthesize them a row at a time with `geomag_grid_row` and write them
+// with independent MPI-IO into one shared file.
+//
+// The file is a header, the axes, then the field in ITRF frame [T] as
+// float64 `bx by bz` ordered by height, latitude, then longitude, all
+// little-endian, so it is only written on little-endian hosts:
+//
+//     char magic[8] = "GMGRID1"
+//     uint64 num_heights, num_lats, num_lons
+//     float64 dyear
+//     float64 heights[num_heights] [m], lats[num_lats] [rad], lons[num_lons] [rad]
+//     float64 mag[num_heights][num_lats][num_lons][3] [T]
+//
+// Usage: geomag-grid-mpi -t dyear -a h0:h1:nh -l lat0:lat1:nlat -n nlon
+//     [-b band] [-s shell] [-m model.COF] output
+// with heights in km and latitudes in degrees, `band` latitudes per tile
+// and `shell` heights per tile.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "geomag_tools.h"
+
+static const char GRID_MAGIC[8] = {'G', 'M', 'G', 'R', 'I', 'D', '1', '\0'};
+
+static const double PI = 3.14159265358979323846;
+
+struct grid {
+    real dyear;
+    uint64_t num_heights, num_lats, num_lons;
+    real *heights, *lats, *lons;
+    // Tile size in latitudes and heights
+    uint64_t band, shell;
+};
+
+// Parses `first:last:count` into a uniform axis
+static int make_axis(const char *text, const double scale, uint64_t *count, real **axis) {
+    real first, last;
+    size_t n;
+    if (parse_axis(text, scale, &first, &last, &n) != 0) {
+        return -1;
+    }
+    *count = n;
+    *axis = malloc(n * sizeof(real));
+    if (*axis == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const real step = (n > 1) ? (last - first) / (real) (n - 1) : 0;
+        (*axis)[i] = first + step * (real) i;
+    }
+    return 0;
+}
+
+// Bytes before the field data
+static MPI_Offset header_size(const struct grid *g) {
+    const uint64_t axes = g->num_heights + g->num_lats + g->num_lons;
+    return (MPI_Offset) (sizeof(GRID_MAGIC) + 3 * sizeof(uint64_t) + sizeof(double) + axes * sizeof(double));
+}
+
+// Writes doubles at an offset, split so each write's count fits an int
+static int write_doubles(MPI_File file, MPI_Offset offset, const double *values, uint64_t count) {
+    int err = MPI_SUCCESS;
+    while (count > 0 && err == MPI_SUCCESS) {
+        const int n = (count < (uint64_t) INT_MAX) ? (int) count : INT_MAX;
+        err = MPI_File_write_at(file, offset, values, n, MPI_DOUBLE, MPI_STATUS_IGNORE);
+        values += n;
+        offset += (MPI_Offset) n * (MPI_Offset) sizeof(double);
+        count -= (uint64_t) n;
+    }
+    return err != MPI_SUCCESS;
+}
+
+// Writes the header and axes, from rank 0
+static int write_header(MPI_File file, const struct grid *g) {
+    uint64_t dims[3] = {g->num_heights, g->num_lats, g->num_lons};
+    double dyear = (double) g->dyear;
+    MPI_Offset offset = 0;
+    int err = MPI_File_write_at(file, offset, GRID_MAGIC, 8, MPI_CHAR, MPI_STATUS_IGNORE);
+    offset += 8;
+    err |= MPI_File_write_at(file, offset, dims, 3, MPI_UINT64_T, MPI_STATUS_IGNORE);
+    offset += (MPI_Offset) sizeof(dims);
+    err |= MPI_File_write_at(file, offset, &dyear, 1, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    offset += (MPI_Offset) sizeof(double);
+    err = (err != MPI_SUCCESS) || write_doubles(file, offset, g->heights, g->num_heights);
+    offset += (MPI_Offset) (g->num_heights * sizeof(double));
+    err = err || write_doubles(file, offset, g->lats, g->num_lats);
+    offset += (MPI_Offset) (g->num_lats * sizeof(double));
+    err = err || write_doubles(file, offset, g->lons, g->num_lons);
+    return err;
+}
+
+// Synthesizes and writes this rank's tiles, returns non-zero on error
+static int write_tiles(
+    MPI_File file, const struct geomag_model *model, const struct grid *g, const int rank, const int size
+) {
+    const MPI_Offset data = header_size(g);
+    const uint64_t num_bands = (g->num_lats + g->band - 1) / g->band;
+    const uint64_t num_shells = (g->num_heights + g->shell - 1) / g->shell;
+    // One band of one height is contiguous in the file, so is one write
+    real (*rows)[3] = malloc(g->band * g->num_lons * sizeof(real[3]));
+    if (rows == NULL) {
+        return 1;
+    }
+    int err = 0;
+    for (uint64_t tile = (uint64_t) rank; tile < num_bands * num_shells && !err; tile += (uint64_t) size) {
+        const uint64_t lat0 = (tile % num_bands) * g->band;
+        const uint64_t h0 = (tile / num_bands) * g->shell;
+        const uint64_t lat1 = (lat0 + g->band < g->num_lats) ? lat0 + g->band : g->num_lats;
+        const uint64_t h1 = (h0 + g->shell < g->num_heights) ? h0 + g->shell : g->num_heights;
+        for (uint64_t h = h0; h < h1 && !err; ++h) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+            for (uint64_t lat = lat0; lat < lat1; ++lat) {
+                geomag_grid_row(
+                    model, g->dyear, g->lats[lat], g->heights[h], g->num_lons, g->lons,
+                    &rows[(lat - lat0) * g->num_lons]
+                );
+            }
+            const MPI_Offset offset = data + (MPI_Offset) ((h * g->num_lats + lat0) * g->num_lons * sizeof(real[3]));
+            const uint64_t count = (lat1 - lat0) * g->num_lons * 3;
+            err = write_doubles(file, offset, &rows[0][0], count);
+        }
+    }
+    free(rows);
+    return err;
+}
+
+static void usage(void) {
+    fprintf(
+        stderr,
+        "usage: geomag-grid-mpi -t dyear -a h0:h1:nh -l lat0:lat1:nlat -n nlon\n"
+        "       [-b band] [-s shell] [-m model.COF] output\n"
+    );
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    static struct geomag_model loaded;
+    const struct geomag_model *model = &WMM2020;
+    struct grid g;
+    memset(&g, 0, sizeof(g));
+    g.dyear = -1;
+    g.band = 16;
+    g.shell = 4;
+    int ok = 1;
+    int opt;
+    while (ok && (opt = getopt(argc, argv, "t:a:l:n:b:s:m:")) != -1) {
+        switch (opt) {
+        case 't':
+            g.dyear = (real) atof(optarg);
+            break;
+        case 'a':
+            ok = make_axis(optarg, 1000.0, &g.num_heights, &g.heights) == 0;
+            break;
+        case 'l':
+            ok = make_axis(optarg, PI / 180, &g.num_lats, &g.lats) == 0;
+            break;
+        case 'n':
+            g.num_lons = strtoull(optarg, NULL, 10);
+            break;
+        case 'b':
+            g.band = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            g.shell = strtoull(optarg, NULL, 10);
+            break;
+        case 'm':
+            ok = load_model(optarg, &loaded) == 0;
+            model = &loaded;
+            break;
+        default:
+            ok = 0;
+            break;
+        }
+    }
+    ok = ok && optind + 1 == argc && g.dyear >= 0 && g.heights && g.lats && g.num_lons > 0 && g.band > 0
+        && g.shell > 0;
+    if (ok) {
+        // Longitudes cover the full circle without repeating the seam
+        g.lons = malloc(g.num_lons * sizeof(real));
+        ok = g.lons != NULL;
+        for (uint64_t i = 0; ok && i < g.num_lons; ++i) {
+            g.lons[i] = (real) (-PI + 2 * PI * (double) i / (double) g.num_lons);
+        }
+    }
+    if (!ok) {
+        if (rank == 0) {
+            usage();
+        }
+        MPI_Finalize();
+        return 2;
+    }
+    const uint16_t probe = 1;
+    if (sizeof(real) != sizeof(double) || *(const unsigned char *) &probe != 1) {
+        if (rank == 0) {
+            fprintf(stderr, "geomag-grid-mpi: grid files need a little-endian host with double reals\n");
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    MPI_File file = MPI_FILE_NULL;
+    int err = MPI_File_open(
+        MPI_COMM_WORLD, argv[optind], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file
+    ) != MPI_SUCCESS;
+    if (!err) {
+        // Drop anything past the end of an older, larger grid
+        const MPI_Offset total = header_size(&g)
+            + (MPI_Offset) (g.num_heights * g.num_lats * g.num_lons * sizeof(real[3]));
+        err = MPI_File_set_size(file, total) != MPI_SUCCESS;
+    }
+    if (!err) {
+        if (rank == 0) {
+            err = write_header(file, &g);
+        }
+        err |= write_tiles(file, model, &g, rank, size);
+    }
+    if (file != MPI_FILE_NULL) {
+        MPI_File_close(&file);
+    }
+    int any_err = 0;
+    MPI_Allreduce(&err, &any_err, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (any_err && rank == 0) {
+        fprintf(stderr, "geomag-grid-mpi: cannot write %s\n", argv[optind]);
+    }
+    free(g.heights);
+    free(g.lats);
+    free(g.lons);
+    MPI_Finalize();
+    return any_err ? 1 : 0;
+}
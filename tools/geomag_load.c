@@ -0,0 +1,297 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// geomag-load: load generator for geomag-daemon.
+//
+// Starts `clients` threads, each with its own connection and shared
+// buffer, sending `requests` requests of `records` random positions each
+// back to back. Reports the throughput and the latency percentiles of the
+// round trips. The first answer of every client is also checked against a
+// local evaluation, of the model the daemon is expected to serve.
+//
+// Usage: geomag-load [-c clients] [-n requests] [-k records] [-m model.COF] socket
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../geomag.h"
+#include "geomag_daemon.h"
+#include "geomag_tools.h"
+
+struct load {
+    const char *path;
+    const struct geomag_model *model;
+    size_t requests, records;
+};
+
+struct worker {
+    const struct load *load;
+    int index;
+    // Round trip of each request [s]
+    double *latency;
+    struct timespec start, end;
+    int status;
+};
+
+static double seconds(const struct timespec *t) {
+    return (double) t->tv_sec + 1e-9 * (double) t->tv_nsec;
+}
+
+// Connects and hands the daemon a shared buffer, returns the socket or -1
+static int connect_daemon(const char *path, const int index, const size_t capacity, real **buffer) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0 || connect(fd, (const struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "geomag-load: cannot connect to %s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    // The name is removed right away, the descriptors keep the memory
+    char name[64];
+    snprintf(name, sizeof(name), "/geomag-load.%ld.%d", (long) getpid(), index);
+    const int shm = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (shm >= 0) {
+        shm_unlink(name);
+    }
+    const size_t size = GEOMAG_DAEMON_BUFFER_SIZE(capacity);
+    void *map = (shm >= 0 && ftruncate(shm, (off_t) size) == 0)
+        ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0) : MAP_FAILED;
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "geomag-load: cannot create shared memory: %s\n", strerror(errno));
+        if (shm >= 0) {
+            close(shm);
+        }
+        close(fd);
+        return -1;
+    }
+
+    const struct geomag_daemon_hello hello = {GEOMAG_DAEMON_MAGIC, 0, capacity};
+    union {
+        struct cmsghdr align;
+        char bytes[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {(void *) &hello, sizeof(hello)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.bytes;
+    msg.msg_controllen = sizeof(control.bytes);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &shm, sizeof(int));
+    struct geomag_daemon_reply reply;
+    const int ok = sendmsg(fd, &msg, 0) == (ssize_t) sizeof(hello)
+        && recv(fd, &reply, sizeof(reply), 0) == (ssize_t) sizeof(reply) && reply.status == 0;
+    close(shm);
+    if (!ok) {
+        fprintf(stderr, "geomag-load: daemon refused the shared buffer\n");
+        munmap(map, size);
+        close(fd);
+        return -1;
+    }
+    *buffer = map;
+    return fd;
+}
+
+static void *run_worker(void *arg) {
+    struct worker *w = arg;
+    const size_t records = w->load->records;
+    w->status = 1;
+    real *buffer;
+    const int fd = connect_daemon(w->load->path, w->index, records, &buffer);
+    if (fd < 0) {
+        return NULL;
+    }
+    real (*in)[4] = (real (*)[4]) buffer;
+    real (*out)[3] = (real (*)[3]) (in + records);
+    real (*expected)[3] = malloc(records * sizeof(real[3]));
+    if (expected == NULL) {
+        fprintf(stderr, "geomag-load: out of memory\n");
+        munmap(buffer, GEOMAG_DAEMON_BUFFER_SIZE(records));
+        close(fd);
+        return NULL;
+    }
+
+    // Positions from low orbit to a few Earth radii
+    uint64_t state = 0x9E3779B97F4A7C15u * (uint64_t) (w->index + 1);
+    for (size_t i = 0; i < records; ++i) {
+        real u[4];
+        for (int k = 0; k < 4; ++k) {
+            state = state * 6364136223846793005u + 1442695040888963407u;
+            u[k] = (real) (state >> 11) / (real) (((uint64_t) 1) << 53);
+        }
+        const real r = 6.5e6 + 2e7 * u[0];
+        const real z = 2 * u[1] - 1;
+        const real s = REAL_SQRT(1 - z * z);
+        in[i][0] = 2020 + 5 * u[3];
+        in[i][1] = r * s * REAL_COS(6.283185307179586 * u[2]);
+        in[i][2] = r * s * REAL_SIN(6.283185307179586 * u[2]);
+        in[i][3] = r * z;
+    }
+    geomag_batch_strided(
+        w->load->model, records, &in[0][0], sizeof(real[4]), &in[0][1], sizeof(real[4]), GEOMAG_FRAME_ITRF, NULL, 0,
+        &expected[0][0], sizeof(real[3])
+    );
+
+    const struct geomag_daemon_request request = {records};
+    int status = 0;
+    clock_gettime(CLOCK_MONOTONIC, &w->start);
+    for (size_t n = 0; n < w->load->requests && status == 0; ++n) {
+        struct timespec sent, answered;
+        struct geomag_daemon_reply reply;
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        if (send(fd, &request, sizeof(request), 0) != (ssize_t) sizeof(request)
+            || recv(fd, &reply, sizeof(reply), 0) != (ssize_t) sizeof(reply) || reply.status != 0) {
+            fprintf(stderr, "geomag-load: request failed\n");
+            status = 1;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &answered);
+        w->latency[n] = seconds(&answered) - seconds(&sent);
+        if (n == 0 && memcmp(out, expected, records * sizeof(real[3])) != 0) {
+            fprintf(stderr, "geomag-load: daemon results differ from local evaluation\n");
+            status = 1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &w->end);
+    free(expected);
+    munmap(buffer, GEOMAG_DAEMON_BUFFER_SIZE(records));
+    close(fd);
+    w->status = status;
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b) {
+    const double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: geomag-load [-c clients] [-n requests] [-k records] [-m model.COF] socket\n");
+}
+
+int main(int argc, char **argv) {
+    static struct geomag_model loaded;
+    struct load load = {NULL, &WMM2020, 1000, 64};
+    int clients = 4;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:k:m:h")) != -1) {
+        switch (opt) {
+        case 'c':
+            clients = atoi(optarg);
+            break;
+        case 'n':
+            load.requests = (size_t) atol(optarg);
+            break;
+        case 'k':
+            load.records = (size_t) atol(optarg);
+            break;
+        case 'm':
+            if (load_model(optarg, &loaded) != 0) {
+                fprintf(stderr, "geomag-load: cannot load model %s\n", optarg);
+                return 1;
+            }
+            load.model = &loaded;
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (optind + 1 != argc || clients <= 0 || load.requests == 0 || load.records == 0) {
+        usage();
+        return 2;
+    }
+    load.path = argv[optind];
+
+    const size_t total = (size_t) clients * load.requests;
+    double *latency = malloc(total * sizeof(double));
+    struct worker *workers = calloc((size_t) clients, sizeof(*workers));
+    pthread_t *threads = malloc((size_t) clients * sizeof(*threads));
+    if (latency == NULL || workers == NULL || threads == NULL) {
+        fprintf(stderr, "geomag-load: out of memory\n");
+        free(latency);
+        free(workers);
+        free(threads);
+        return 1;
+    }
+    for (int i = 0; i < clients; ++i) {
+        workers[i].load = &load;
+        workers[i].index = i;
+        workers[i].latency = latency + (size_t) i * load.requests;
+        pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+    int status = 0;
+    double start = 0, end = 0;
+    for (int i = 0; i < clients; ++i) {
+        pthread_join(threads[i], NULL);
+        status |= workers[i].status;
+        const double s = seconds(&workers[i].start), e = seconds(&workers[i].end);
+        start = (i == 0 || s < start) ? s : start;
+        end = (i == 0 || e > end) ? e : end;
+    }
+
+    if (status == 0) {
+        qsort(latency, total, sizeof(double), compare_double);
+        const double elapsed = end - start;
+        printf(
+            "%zu requests of %zu records from %d clients in %.3f s\n", total, load.records, clients, elapsed
+        );
+        printf(
+            "throughput: %.0f requests/s, %.0f records/s\n", (double) total / elapsed,
+            (double) (total * load.records) / elapsed
+        );
+        printf(
+            "latency: p50 %.1f us, p99 %.1f us, max %.1f us\n", 1e6 * latency[(total - 1) / 2],
+            1e6 * latency[(size_t) (0.99 * (double) (total - 1))], 1e6 * latency[total - 1]
+        );
+    }
+    free(latency);
+    free(workers);
+    free(threads);
+    return status;
+}
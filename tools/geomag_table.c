@@ -0,0 +1,174 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// geomag-table: builds a precomputed field table once for many processes.
+//
+// Writes a `geomag_table` for a model and grid to a file, for example under
+// /dev/shm, which worker processes then map read-only with
+// `mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0)` and open in place with
+// `geomag_table_open`, so one copy in memory serves every process on the
+// host. If the file already holds the same table it is left alone,
+// otherwise the table is built into a temporary file next to it and renamed
+// over it, so readers see either the old table or the whole new one.
+//
+// Usage: geomag-table -t dyear0:dyear1:n -a h0:h1:nh -l lat0:lat1:nlat -n nlon
+//     [-m model.COF] [-f] output
+// with heights in km and latitudes in degrees. `-f` rebuilds even if the
+// table is up to date.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../geomag_table.h"
+#include "geomag_tools.h"
+
+static const double PI = 3.14159265358979323846;
+
+// Whether a file already holds the table
+static int up_to_date(const char *path, const struct geomag_model *model, const struct geomag_table_spec *spec) {
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    const size_t size = (size_t) st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    struct geomag_table table;
+    const int ok = geomag_table_open(map, size, model, spec, &table) == 0;
+    munmap(map, size);
+    return ok;
+}
+
+// Builds the table into a temporary file and renames it over `path`
+static int build(const char *path, const struct geomag_model *model, const struct geomag_table_spec *spec) {
+    const size_t size = geomag_table_size(spec);
+    const size_t len = strlen(path);
+    char *temp = malloc(len + 8);
+    if (temp == NULL) {
+        return -1;
+    }
+    memcpy(temp, path, len);
+    memcpy(temp + len, ".XXXXXX", 8);
+    const int fd = mkstemp(temp);
+    if (fd < 0) {
+        free(temp);
+        return -1;
+    }
+    void *map = (ftruncate(fd, (off_t) size) == 0)
+        ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    int status = -1;
+    if (map != MAP_FAILED) {
+        status = geomag_table_build(model, spec, map, size);
+        status |= munmap(map, size);
+    }
+    // Readers only ever map it read-only
+    status |= fchmod(fd, 0444);
+    status |= close(fd);
+    if (status == 0) {
+        status = rename(temp, path);
+    }
+    if (status != 0) {
+        unlink(temp);
+    }
+    free(temp);
+    return (status == 0) ? 0 : -1;
+}
+
+static void usage(void) {
+    fprintf(
+        stderr,
+        "usage: geomag-table -t dyear0:dyear1:n -a h0:h1:nh -l lat0:lat1:nlat -n nlon\n"
+        "                    [-m model.COF] [-f] output\n"
+    );
+}
+
+int main(int argc, char **argv) {
+    static struct geomag_model loaded;
+    const struct geomag_model *model = &WMM2020;
+    struct geomag_table_spec spec;
+    memset(&spec, 0, sizeof(spec));
+    int force = 0;
+    int ok = 1;
+    int opt;
+    while (ok && (opt = getopt(argc, argv, "t:a:l:n:m:f")) != -1) {
+        switch (opt) {
+        case 't':
+            ok = parse_axis(optarg, 1, &spec.dyear0, &spec.dyear1, &spec.num_epochs) == 0;
+            break;
+        case 'a':
+            ok = parse_axis(optarg, 1000.0, &spec.height0, &spec.height1, &spec.num_heights) == 0;
+            break;
+        case 'l':
+            ok = parse_axis(optarg, PI / 180, &spec.lat0, &spec.lat1, &spec.num_lats) == 0;
+            break;
+        case 'n':
+            spec.num_lons = strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            if (load_model(optarg, &loaded) != 0) {
+                fprintf(stderr, "geomag-table: cannot load model %s\n", optarg);
+                return 1;
+            }
+            model = &loaded;
+            break;
+        case 'f':
+            force = 1;
+            break;
+        default:
+            ok = 0;
+            break;
+        }
+    }
+    if (!ok || optind + 1 != argc || geomag_table_size(&spec) == 0) {
+        usage();
+        return 2;
+    }
+    const char *path = argv[optind];
+    if (!force && up_to_date(path, model, &spec)) {
+        fprintf(stderr, "geomag-table: %s is up to date\n", path);
+        return 0;
+    }
+    if (build(path, model, &spec) != 0) {
+        fprintf(stderr, "geomag-table: cannot write %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "geomag-table: wrote %zu bytes to %s\n", geomag_table_size(&spec), path);
+    return 0;
+}
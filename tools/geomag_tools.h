@@ -0,0 +1,61 @@
+/*
+MIT License
+
+Copyright (c) 2019 Nathan Zimmerberg
+Copyright (c) 2021 Gunvir Ranu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Command line helpers shared by the tools.
+
+#ifndef GEOMAG_TOOLS_H
+#define GEOMAG_TOOLS_H
+
+#include <stdio.h>
+
+#include "../geomag_cof.h"
+
+// Loads a COF model file, returns -1 if it can't be read or parsed
+static inline int load_model(const char *path, struct geomag_model *model) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    const int status = geomag_model_read_cof(file, model);
+    fclose(file);
+    return status;
+}
+
+// Parses `first:last:count` for a uniform axis, scaling the ends, returns -1
+// if malformed or empty
+static inline int parse_axis(const char *text, const double scale, real *first, real *last, size_t *count) {
+    double a, b;
+    unsigned long n;
+    char extra;
+    if (sscanf(text, "%lf:%lf:%lu%c", &a, &b, &n, &extra) != 3 || n == 0) {
+        return -1;
+    }
+    *first = (real) (a * scale);
+    *last = (real) (b * scale);
+    *count = n;
+    return 0;
+}
+
+#endif // GEOMAG_TOOLS_H